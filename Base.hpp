@@ -13,6 +13,7 @@
 #include <sstream>
 #include <utility>
 #include <type_traits>
+#include <cstdint>
 
 #if defined(_MSC_VER)
 #include <sal.h>
@@ -31,7 +32,10 @@ namespace text_processing {
 
 	typedef std::vector<path> searchPaths;
 
-	std::expected<path, ErrorResponse> locateFile(const path &filepath, const path &source_filepath = std::filesystem::current_path(), const searchPaths& search_paths = {}, bool specfile_path_is_also_search_path = true, bool accept_absolute_paths = true, bool accept_relative_paths = true);
+	class FileLookupCache;
+
+	// Pass a `lookup_cache` (see FileLookupCache.hpp) when you'll be locating many files in the same few directories.
+	std::expected<path, ErrorResponse> locateFile(const path &filepath, const path &source_filepath = std::filesystem::current_path(), const searchPaths& search_paths = {}, bool specfile_path_is_also_search_path = true, bool accept_absolute_paths = true, bool accept_relative_paths = true, FileLookupCache *lookup_cache = nullptr);
 
 	// Return a relative path, that's relative to the given `base_filepath`.
 	std::expected<path, ErrorResponse> ConvertToRelativePath(const path &filepath, const path &base_filepath = std::filesystem::current_path());
@@ -675,16 +679,70 @@ namespace text_processing {
 
 	// ---------------------------------------------------------------
 
+	// A bump allocator for `TextBuffer` storage: hand it to `TextBuffer::reserve()` (or set `FileContentProcessingOptions::arena`)
+	// and a whole batch of file contents, including their scratch space, lives in a few large slabs instead of one
+	// malloc'ed chunk each.
+	//
+	// Buffers never release their arena memory themselves: `reset()` recycles all of it at once, in O(1).
+	// Hence the arena MUST outlive the buffers allocated from it, and all of those are invalidated by `reset()`.
+	//
+	// NOTE: the arena is NOT thread-safe: use one arena per thread.
+	class TextBufferArena {
+	public:
+		static constexpr const size_t default_slab_size = 16 * 1024 * 1024;
+		static constexpr const size_t alignment = 64;		// cache line; also suits any SIMD code scanning the buffers.
+
+		explicit TextBufferArena(size_t slab_size = default_slab_size);
+		~TextBufferArena();
+
+		TextBufferArena(const TextBufferArena &) = delete;
+		TextBufferArena &operator=(const TextBufferArena &) = delete;
+		TextBufferArena(TextBufferArena &&src) noexcept;
+		TextBufferArena &operator=(TextBufferArena &&src) noexcept;
+
+		// returns nullptr when out of memory.
+		char *allocate(size_t amount) noexcept;
+
+		// recycle all memory handed out so far; the slabs are kept for reuse.
+		void reset() noexcept;
+
+		// return all slabs to the system.
+		void release() noexcept;
+
+		// total size of the slabs held by this arena.
+		size_t slab_space() const noexcept;
+
+	protected:
+		struct Slab {
+			char *base;
+			size_t size;
+		};
+
+		size_t _slab_size;
+		std::vector<Slab> _slabs;
+		size_t _current = 0;		// index of the slab we're currently allocating from
+		size_t _offset = 0;			// first free byte in that slab
+	};
+
 	class TextBuffer {
 	public:
 		using size_type         = size_t;
 		using difference_type   = ptrdiff_t;
 
+		// where the buffer memory came from, hence how it must be released again.
+		enum class StorageKind : uint8_t {
+			Heap = 0,
+			MemoryMapped,		// file content mapped straight from the OS page cache, followed by anonymous scratch memory. See `map_file()`.
+			Arena,				// a chunk of a `TextBufferArena` slab: the arena owns the memory.
+			Aligned,			// heap memory with a coarser alignment than `malloc()` provides, e.g. for O_DIRECT reads. See `reserve_aligned()`.
+		};
+
 	protected:
 		char *_data = nullptr;
 		size_type _length = 0;     // length of the 'source text' (which starts at buffer offset 0)
 		size_type _occupied = 0;	// any bytes in the buffer (capacity) are available for allocation.
 		size_type _capacity = 0;
+		StorageKind _storage = StorageKind::Heap;
 
 	public:
 		static constexpr const size_type sentinel_size = 32;
@@ -712,6 +770,18 @@ namespace text_processing {
 
 		void reserve(size_type amount);
 		void reserve(size_type amount, std::error_code &ec);
+		// like `reserve()`, but allocates from `arena`.
+		void reserve(size_type amount, TextBufferArena &arena, std::error_code &ec);
+
+		// like `reserve()`, but the buffer starts at an `alignment` boundary (a power of 2) and its capacity, sentinel
+		// included, is rounded up to a multiple of `alignment`: as needed for direct (unbuffered) I/O, which transfers
+		// whole disk blocks straight into the buffer.
+		void reserve_aligned(size_type amount, size_type alignment, std::error_code &ec);
+
+		// enlarge an already reserved buffer to `amount` bytes (plus sentinel), keeping everything in it.
+		// Heap buffers are `realloc()`ed; arena buffers move to the heap (the arena space is abandoned: arenas only ever
+		// release their memory wholesale); aligned buffers keep their alignment; memory mapped buffers cannot grow.
+		void grow(size_type amount, std::error_code &ec);
 
 		constexpr char *data() const {
 			return _data;
@@ -729,8 +799,9 @@ namespace text_processing {
 		constexpr std::string_view content_view() const {
 			return {_data, _length};
 		}
+		// the scratch space: the buffer space beyond the occupied part.
 		constexpr std::string_view available_space_view() {
-			return {_data, _length};
+			return {_data + _occupied, _capacity - _occupied};
 		}
 		constexpr std::string_view capacity_view() const {
 			return {_data, _capacity};
@@ -741,6 +812,10 @@ namespace text_processing {
 		// This also marks all buffer capacity beyond this point as 'available', i.e. NOT 'occupied'.
 		void write_text_edge_sentinel(void);
 
+		// like `write_text_edge_sentinel()`, but leaves any scratch space which has already been occupied (by an earlier
+		// content rewriting pass) alone.
+		void ensure_text_edge_sentinel(void);
+
 		void set_content_size(size_type amount);
 
 		void mark_this_space_as_occupied(size_type amount);
@@ -748,6 +823,22 @@ namespace text_processing {
 		// like assignment operator, but with the option to request additional scratch space by specifying a larger `requested_buffer_size`.
 		void CopyAndPrepare(const char *str, size_type strlength, size_type requested_buffer_size, std::error_code &ec);
 
+		// zero-copy alternative to `reserve()` + `fread()`: map the first `filesize` bytes of the open file `fd` into the buffer.
+		// The content is served straight from the OS page cache (read-only), followed by the NUL sentinel and anonymous
+		// scratch space up to a total of `requested_buffer_size` bytes.
+		//
+		// NOTE: the file MUST NOT shrink while it is mapped or you'll be treated to a SIGBUS.
+		void map_file(int fd, size_type filesize, size_type requested_buffer_size, std::error_code &ec);
+
+		constexpr StorageKind storage_kind() const {
+			return _storage;
+		}
+
+		// debug aid: the number of times any buffer content has been copied by the `TextBuffer` copy constructor or
+		// copy assignment, i.e. the number of (potentially large) buffer duplications. Use this to verify that buffers are
+		// moved, rather than copied, along the data path.
+		static size_t content_copy_count() noexcept;
+
 		// nuke/reset the Textbuffer
 		void clear(void);
 	};
@@ -130,11 +130,104 @@ BENCHMARK_F(SplitFileContentsFixture, BM_WithFixture_1)(benchmark::State& state)
 }
 
 
+// parseContentAsWords():
+//
+// the target: within 1.5x of the line splitter (BM_WithFixture_1) on the same input.
+
+BENCHMARK_F(SplitFileContentsFixture, BM_WithFixture_Words)(benchmark::State& state) {
+	size_t size_4_stats = 0;
+	size_t items_4_stats = 0;
+
+	for (auto _ : state) {
+		FileContentProcessingOptions proc_opts = {
+			.mode = FileContentProcessingOptions::ParseMode::ToWords,
+		};
+
+		// preparation takes a while for very large input files...
+		state.PauseTiming();
+		ExtendedFileContent rv(this->data);
+		state.ResumeTiming();
+
+		std::error_code ec;
+		rv.parseContentAsWords(proc_opts, ec);
+		assert(!ec);
+		assert(rv.words.size() > 10);
+
+		state.PauseTiming();
+		items_4_stats = rv.words.size();
+		size_4_stats = this->data.content_length();
+		state.ResumeTiming();
+	}
+
+	state.SetBytesProcessed(state.iterations() * size_4_stats);
+	state.SetItemsProcessed(state.iterations() * items_4_stats);
+}
+
+
 #if 0   // BENCHMARK_F() already registers the benchmark method.
 BENCHMARK_REGISTER_F(SplitFileContentsFixture, BM_WithFixture);
 #endif
 
 
+// the `lines` reservation: heuristic (content size / 10) vs. exact (`exact_reservation`: counting pre-pass).
+//
+// Two synthetic file shapes at either end of the spectrum:
+// - shape 0: a directory listing, ~120 bytes per line; the heuristic over-reserves ~12x.
+// - shape 1: a word list, ~8 bytes per line; the heuristic under-reserves and the list gets reallocated several times.
+//
+// Args: (shape, exact)
+
+static TextBuffer make_line_reservation_test_content(int shape) {
+	std::string text;
+	text.reserve(64 * 1024 * 1024 + 256);
+	for (size_t i = 0; text.size() < 64 * 1024 * 1024; i++) {
+		if (shape == 0)
+			text += std::format("C:/Users/someone/projects/text-processing/assets/corpus/section-{:04}/chapter-{:06}/document-{:08}.txt\r\n", i % 97, i % 9973, i);
+		else
+			text += std::format("w{:04x}\n", i & 0xFFFF);
+	}
+	return TextBuffer(text);
+}
+
+static void BM_LineReservation(benchmark::State& state) {
+	const int shape = int(state.range(0));
+	const bool exact = !!state.range(1);
+
+	static TextBuffer content[2] = { make_line_reservation_test_content(0), make_line_reservation_test_content(1) };
+	const TextBuffer &data = content[shape];
+
+	size_t items_4_stats = 0;
+	size_t reserved_4_stats = 0;
+
+	for (auto _ : state) {
+		FileContentProcessingOptions proc_opts = {
+			.mode = FileContentProcessingOptions::ParseMode::ToTextLines,
+		};
+		proc_opts.exact_reservation = exact;
+
+		// preparation takes a while for very large input files...
+		state.PauseTiming();
+		ExtendedFileContent rv(data);
+		state.ResumeTiming();
+
+		std::error_code ec;
+		rv.parseContentAsLines(proc_opts, ec);
+		assert(!ec);
+
+		state.PauseTiming();
+		items_4_stats = rv.lines.size();
+		reserved_4_stats = rv.lines.capacity();
+		state.ResumeTiming();
+	}
+
+	state.SetBytesProcessed(state.iterations() * data.content_length());
+	state.SetItemsProcessed(state.iterations() * items_4_stats);
+	// list slots allocated per line found: 1.0 is perfect.
+	state.counters["reserved_per_line"] = double(reserved_4_stats) / double(std::max<size_t>(items_4_stats, 1));
+}
+BENCHMARK(BM_LineReservation)->Args({0, 0})->Args({0, 1})->Args({1, 0})->Args({1, 1})->Unit(benchmark::kMillisecond);
+
+
 static inline bool is_blank(const char c) {
 	return c == ' ' || c == '\t';
 }
@@ -76,6 +76,7 @@ BM_ReadFileContents_Style_8               69748820 ns     70312500 ns
 */
 
 #include "ReadFileContents.hpp"
+#include "RawTextIngest.hpp"
 #include "PrivateUtilities.hpp"
 
 #include <libassert/assert.h>
@@ -92,6 +93,9 @@ BM_ReadFileContents_Style_8               69748820 ns     70312500 ns
 
 #undef min
 #undef max
+#else
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #define BENCHMARK_FAMILY_ID     "chewing_text_cud"
@@ -427,14 +431,260 @@ static void BM_ReadFileContents_Style_8(benchmark::State& state) {
 	state.SetBytesProcessed(state.iterations() * size_4_stats);
 }
 
+#else
+
+// POSIX: raw open(O_CLOEXEC) + fstat() on the open handle + posix_fadvise(SEQUENTIAL) + read() until EOF,
+// using FileReader::openRaw() and FileReader::readAllContentUntilEOF(), BINARY mode, TextBuffer instead of std::string:
+//
+// no separate `fs::file_size()` path lookup and no stdio buffering layer in between.
+static void BM_ReadFileContents_Style_8(benchmark::State& state) {
+	size_t size_4_stats = 0;
+
+	for (auto _ : state) {
+		auto fspec = locateFile(testfilepath);
+		assert(fspec.has_value());
+		path filepath = fspec.value();
+
+		FileReader reader;
+		auto filesize = reader.openRaw(filepath);
+		if (!filesize.has_value()) {
+			LIBASSERT_UNREACHABLE(std::format("error opening file \"{}\": error {}:{}", filepath.generic_string(), int(filesize.error().code), filesize.error().message));
+		} else {
+			if (false) std::cout << filepath.generic_string() << " size = " << HumanReadable{filesize.value()} << '\n';
+
+			auto len = reader.readAllContentUntilEOF(filesize.value());
+			assert(len.has_value());
+			assert(len.value() == filesize.value());
+			reader.close();
+
+			size_4_stats = reader.data.content_size();
+
+			assert(reader.data.content_size() > 1000);
+		}
+	}
+
+	state.SetBytesProcessed(state.iterations() * size_4_stats);
+}
+
 #endif // defined(_WIN32)
 
 
+// memory mapped, using FileReader::mapAllContent() --> TextBuffer content served straight from the OS page cache:
+//
+// DO NOTE that mapping the file doesn't read anything yet: the cost of faulting in the pages is moved downrange
+// to the first consumer, e.g. the line splitter. To keep this comparable to the other styles, we touch every page
+// of the content here, which is what the splitter would do anyway.
+static void BM_ReadFileContents_Style_9(benchmark::State& state) {
+	size_t size_4_stats = 0;
 
+	for (auto _ : state) {
+		auto fspec = locateFile(testfilepath);
+		assert(fspec.has_value());
+		path filepath = fspec.value();
 
-#if defined(_WIN32)
-BENCHMARK(BM_ReadFileContents_Style_8);
+		std::error_code ec;
+		if (const std::uintmax_t filesize = fs::file_size(filepath, ec); ec) {
+			LIBASSERT_UNREACHABLE(std::format("file size for file \"{}\" cannot be determined; {}", filepath.generic_string(), ec.message()));
+		} else {
+			if (false) std::cout << filepath.generic_string() << " size = " << HumanReadable{filesize} << '\n';
+
+			FileReader reader;
+			auto o = reader.open(filepath);
+			if (o) {
+				LIBASSERT_UNREACHABLE(std::format("error processing file \"{}\": error {}:{}", filepath.generic_string(), int(o.value().code), o.value().message));
+			}
+			auto r = reader.mapAllContent(filesize, filesize + TextBuffer::sentinel_size);
+			if (!r.has_value()) {
+				LIBASSERT_UNREACHABLE(std::format("error processing file \"{}\": error {}:{}", filepath.generic_string(), int(r.error().code), r.error().message));
+			}
+			reader.close();
+
+			std::string_view v = reader.data.content_view();
+			unsigned int sum = 0;
+			for (size_t i = 0; i < v.size(); i += 4096) {
+				sum += static_cast<uint8_t>(v[i]);
+			}
+			benchmark::DoNotOptimize(sum);
+
+			size_4_stats = v.length();
+
+			assert(v.size() > 1000);
+		}
+	}
+
+	state.SetBytesProcessed(state.iterations() * size_4_stats);
+}
+
+
+
+// read + split lines, end to end, through `processFileEx()`: the classic load mode (read everything, then split)
+// vs. the pipelined one (split the blocks already read while the next ones are being read).
+//
+// Arg: load mode
+static void BM_LoadAndSplitLines(benchmark::State& state) {
+	size_t size_4_stats = 0;
+	size_t items_4_stats = 0;
+
+	const FileContentProcessingOptions::LoadMode load_mode = FileContentProcessingOptions::LoadMode(state.range(0));
+
+	for (auto _ : state) {
+		FileContentProcessingOptions proc_opts = {
+			.mode = FileContentProcessingOptions::ParseMode::ToTextLines,
+			.trim_outer_whitespace = true,
+			.accept_comment_lines = true,
+			.load_mode = load_mode,
+		};
+
+		auto r = processFileEx(testfilepath, {}, proc_opts);
+		if (!r.has_value()) {
+			LIBASSERT_UNREACHABLE(std::format("error processing file \"{}\": error {}:{}", testfilepath, int(r.error().code), r.error().message));
+		}
+
+		size_4_stats = r.value().file_content.content_length();
+		items_4_stats = r.value().lines.size();
+	}
+
+	state.SetBytesProcessed(state.iterations() * size_4_stats);
+	state.SetItemsProcessed(state.iterations() * items_4_stats);
+}
+BENCHMARK(BM_LoadAndSplitLines)->Arg(FileContentProcessingOptions::ReadIntoBuffer)->Arg(FileContentProcessingOptions::Pipelined);
+
+
+
+// cold reads: buffered (through the page cache) vs. direct (O_DIRECT, bypassing the page cache) reads of a
+// generated file of the given size.
+//
+// To keep the buffered run honest, the file's pages are dropped from the page cache before each iteration
+// (POSIX_FADV_DONTNEED; untimed), otherwise we'd be benchmarking memcpy() out of the page cache after the first round.
+// DO NOTE that the direct reads fall back to buffered ones when the filesystem holding the temp directory refuses
+// O_DIRECT (tmpfs on older kernels, ...): point TMPDIR at a disk-backed filesystem for meaningful numbers.
+//
+// Args: file size in MB, load mode
+static void BM_ColdRead(benchmark::State& state) {
+	const size_t filesize = size_t(state.range(0)) * 1024 * 1024;
+	const FileContentProcessingOptions::LoadMode load_mode = FileContentProcessingOptions::LoadMode(state.range(1));
+
+	const path filepath = fs::temp_directory_path() / std::format("text_processing_cold_read_{}MB.txt", state.range(0));
+	{
+		std::error_code ec;
+		if (fs::file_size(filepath, ec) != filesize || ec) {
+			std::ofstream f(filepath, std::ios::binary | std::ios::trunc);
+			std::string line;
+			for (size_t written = 0; written < filesize; written += line.size()) {
+				line = std::format("line {} of the cold read test file\n", written);
+				if (written + line.size() > filesize)
+					line.resize(filesize - written);
+				f << line;
+			}
+		}
+	}
+
+	size_t size_4_stats = 0;
+
+	for (auto _ : state) {
+		state.PauseTiming();
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+		if (int fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC); fd >= 0) {
+			(void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			::close(fd);
+		}
 #endif
+		state.ResumeTiming();
+
+		auto r = processFile(filepath, {}, load_mode);
+		if (!r.has_value()) {
+			LIBASSERT_UNREACHABLE(std::format("error processing file \"{}\": error {}:{}", filepath.generic_string(), int(r.error().code), r.error().message));
+		}
+
+		size_4_stats = r.value().file_content.content_length();
+		assert(size_4_stats == filesize);
+	}
+
+	state.SetBytesProcessed(state.iterations() * size_4_stats);
+}
+BENCHMARK(BM_ColdRead)->ArgsProduct({ {64, 512}, {FileContentProcessingOptions::ReadIntoBuffer, FileContentProcessingOptions::DirectIO} })->Unit(benchmark::kMillisecond);
+
+
+
+// the raw-data-to-text stage of the codestripper and strings3 tools: clean up 64MB of generated raw data, which is
+// either plain ASCII text, text with a sprinkling of UTF-8 and CRLF line endings, or the latter plus the occasional
+// UTF-16LE run and a bit of binary noise.
+//
+// Either directly in memory (the data is restored before each iteration; untimed) or through the streaming stage,
+// reading the data from a temp file in chunks.
+//
+// Args: content kind (0: ASCII, 1: UTF-8 + CRLF, 2: UTF-8 + UTF-16 + binary), 0: in memory / 1: streamed from file
+static void BM_RawTextIngest(benchmark::State& state) {
+	const size_t filesize = 64 * 1024 * 1024;
+	const int kind = int(state.range(0));
+	const bool streamed = (state.range(1) != 0);
+
+	std::string raw;
+	raw.reserve(filesize + 256);
+	for (size_t i = 0; raw.size() < filesize; i++) {
+		switch (kind) {
+		case 0:
+			raw += std::format("line {} of the raw ingest test data\n", i);
+			break;
+
+		default:
+			raw += std::format("line {} of the raw ingest test data: caf\xC3\xA9 \xE2\x82\xAC\r\n", i);
+			if (kind == 2 && i % 64 == 7) {
+				for (const char *p = "UTF-16 text\r\n"; *p; p++) {
+					raw += *p;
+					raw += '\0';
+				}
+				raw += std::string(2, '\0');
+				raw += "\x01\x02\xFF\x7F\n";
+			}
+			break;
+		}
+	}
+	raw.resize(filesize);
+
+	const path filepath = fs::temp_directory_path() / std::format("text_processing_raw_ingest_{}.bin", kind);
+	if (streamed) {
+		std::ofstream f(filepath, std::ios::binary | std::ios::trunc);
+		f << raw;
+	}
+
+	std::string buf;
+	std::vector<uint8_t> overflow;
+	RawTextCleanupState cleanup_state;
+	size_t size_4_stats = 0;
+
+	for (auto _ : state) {
+		if (streamed) {
+			RawTextIngest ingest;
+			auto e = ingest.ingest(filepath);
+			if (e) {
+				LIBASSERT_UNREACHABLE(std::format("error processing file \"{}\": error {}:{}", filepath.generic_string(), int(e->code), e->message));
+			}
+			size_4_stats = ingest.text().content_length();
+		} else {
+			state.PauseTiming();
+			buf = raw;
+			buf.append(raw_data_tail_size, '\0');
+			state.ResumeTiming();
+
+			auto r = cleanRawDataIntoText(reinterpret_cast<uint8_t *>(buf.data()), filesize, true, overflow, cleanup_state);
+			size_4_stats = r.written + overflow.size();
+		}
+		benchmark::DoNotOptimize(size_4_stats);
+	}
+
+	state.SetBytesProcessed(state.iterations() * filesize);
+
+	if (streamed) {
+		std::error_code ec;
+		fs::remove(filepath, ec);
+	}
+}
+BENCHMARK(BM_RawTextIngest)->ArgsProduct({ {0, 1, 2}, {0, 1} })->Unit(benchmark::kMillisecond);
+
+
+
+BENCHMARK(BM_ReadFileContents_Style_8);
 BENCHMARK(BM_ReadFileContents_Style_1);
 BENCHMARK(BM_ReadFileContents_Style_2);
 BENCHMARK(BM_ReadFileContents_Style_3);
@@ -442,9 +692,8 @@ BENCHMARK(BM_ReadFileContents_Style_4);
 BENCHMARK(BM_ReadFileContents_Style_5);
 BENCHMARK(BM_ReadFileContents_Style_6);
 BENCHMARK(BM_ReadFileContents_Style_7);
-#if defined(_WIN32)
+BENCHMARK(BM_ReadFileContents_Style_9);
 BENCHMARK(BM_ReadFileContents_Style_8);
-#endif
 
 
 
@@ -0,0 +1,260 @@
+
+#include "CodeStripping.hpp"
+
+#include <string.h>
+
+
+namespace text_processing {
+
+	static constexpr const size_t npos = std::string_view::npos;
+
+	static inline bool is_blank(const char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+	}
+
+	static inline bool is_identifier_char(const char c) {
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || (unsigned char)c >= 0x80;
+	}
+
+	static inline bool is_hex_digit(const char c) {
+		return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+	}
+
+	static inline std::string_view trim(std::string_view s) {
+		size_t b = 0;
+		size_t e = s.size();
+		while (b < e && is_blank(s[b]))
+			b++;
+		while (e > b && is_blank(s[e - 1]))
+			e--;
+		return s.substr(b, e - b);
+	}
+
+	static inline bool ends_with_backslash(std::string_view line) {
+		return !line.empty() && line.back() == '\\';
+	}
+
+	// does `s` (the statement text leading up to a `{`) introduce an `extern "C"` or `namespace` scope?
+	//
+	// Named namespaces are included: their content is usually not indented, so we'd lose it all when we
+	// treated those as regular code scopes.
+	static bool is_transparent_scope_header(std::string_view s) {
+		s = trim(s);
+		if (s.starts_with("extern")) {
+			s = trim(s.substr(6));
+			return s == "\"C\"" || s == "\"C++\"";
+		}
+		if (s.starts_with("inline") && s.size() > 6 && is_blank(s[6])) {
+			s = trim(s.substr(6));
+		}
+		if (!s.starts_with("namespace"))
+			return false;
+		s = s.substr(9);
+		if (!s.empty() && !is_blank(s[0]))
+			return false;
+		// `namespace a::b`, but NOT `namespace fs = std::filesystem;`
+		for (const char c : s) {
+			if (!is_identifier_char(c) && !is_blank(c) && c != ':')
+				return false;
+		}
+		return true;
+	}
+
+	void CodeStripper::reset(void) {
+		_lexical = Lexical::Code;
+		_scopes.clear();
+		_depth = 0;
+		_keep_block_comment = false;
+		_in_preprocessor_line = false;
+		_keep_preprocessor_line = false;
+		_pending_transparent_header = false;
+	}
+
+	size_t CodeStripper::scan_line(std::string_view line, bool count_braces, bool &transparent) {
+		const size_t n = line.size();
+		const char *ptr = line.data();
+		size_t first_open = npos;
+		// where the current statement started: `namespace a { namespace b {` opens two transparent scopes.
+		size_t stmt_start = 0;
+
+		transparent = false;
+		for (size_t i = 0; i < n; i++) {
+			const char c = ptr[i];
+			switch (_lexical) {
+			case Lexical::Code:
+				switch (c) {
+				case '/':
+					if (i + 1 < n) {
+						if (ptr[i + 1] == '/') {
+							_lexical = Lexical::LineComment;
+							i = n;
+						} else if (ptr[i + 1] == '*') {
+							_lexical = Lexical::BlockComment;
+							i++;
+						}
+					}
+					break;
+
+				case '"':
+					_lexical = Lexical::String;
+					break;
+
+				case '\'':
+					// not a digit separator, as in 1'000'000 or 0xFFFF'FFFF?
+					if (i == 0 || i + 1 >= n || !is_hex_digit(ptr[i - 1]) || !is_hex_digit(ptr[i + 1]))
+						_lexical = Lexical::Char;
+					break;
+
+				case ';':
+					stmt_start = i + 1;
+					break;
+
+				case '{':
+					if (count_braces) {
+						const bool at_top = (_depth == 0);
+						const std::string_view header = line.substr(stmt_start, i - stmt_start);
+						const bool is_transparent = at_top && (is_transparent_scope_header(header) || (_pending_transparent_header && trim(header).empty()));
+						_scopes.push_back(is_transparent);
+						if (!is_transparent)
+							_depth++;
+						if (at_top && first_open == npos) {
+							first_open = i;
+							transparent = is_transparent;
+						}
+						_pending_transparent_header = false;
+					}
+					stmt_start = i + 1;
+					break;
+
+				case '}':
+					if (count_braces && !_scopes.empty()) {
+						if (!_scopes.back())
+							_depth--;
+						_scopes.pop_back();
+					}
+					stmt_start = i + 1;
+					break;
+				}
+				break;
+
+			case Lexical::LineComment:
+				i = n;
+				break;
+
+			case Lexical::BlockComment:
+				if (c == '*' && i + 1 < n && ptr[i + 1] == '/') {
+					_lexical = Lexical::Code;
+					i++;
+				}
+				break;
+
+			case Lexical::String:
+				if (c == '\\')
+					i++;
+				else if (c == '"')
+					_lexical = Lexical::Code;
+				break;
+
+			case Lexical::Char:
+				if (c == '\\')
+					i++;
+				else if (c == '\'')
+					_lexical = Lexical::Code;
+				break;
+			}
+		}
+
+		// line comments end at the end of the line; so do (unterminated) literals. Unless the line is continued.
+		if (_lexical != Lexical::Code && _lexical != Lexical::BlockComment && !ends_with_backslash(line))
+			_lexical = Lexical::Code;
+
+		return first_open;
+	}
+
+	void CodeStripper::strip_line(std::string_view line, std::vector<std::string_view> &lines) {
+		bool transparent;
+
+		// the continuation of a preprocessor statement:
+		if (_in_preprocessor_line) {
+			if (_keep_preprocessor_line && !line.empty())
+				lines.push_back(line);
+			_in_preprocessor_line = ends_with_backslash(line);
+			(void)scan_line(line, false, transparent);
+			return;
+		}
+
+		// the continuation of a multi-line C comment: kept when it started at the left edge, outside any scope.
+		if (_lexical == Lexical::BlockComment) {
+			if (_keep_block_comment && !line.empty())
+				lines.push_back(line);
+			(void)scan_line(line, true, transparent);
+			if (_lexical != Lexical::BlockComment)
+				_keep_block_comment = false;
+			return;
+		}
+
+		// ditch empty lines
+		if (line.empty())
+			return;
+
+		// preprocessor statements are never part of the brace bookkeeping; only the top-level `#define`s survive.
+		const size_t first = line.find_first_not_of(" \t\f\v");
+		if (line[first] == '#') {
+			std::string_view directive = trim(line.substr(first + 1));
+			_keep_preprocessor_line = (first == 0 && _depth == 0 && directive.starts_with("define") && (directive.size() == 6 || !is_identifier_char(directive[6])));
+			if (_keep_preprocessor_line)
+				lines.push_back(line);
+			_in_preprocessor_line = ends_with_backslash(line);
+			(void)scan_line(line, false, transparent);
+			return;
+		}
+
+		// anything inside a code scope, or not at the left edge, is discarded, but we MUST keep track of the braces.
+		if (_depth > 0 || first > 0 || line[0] == '}') {
+			(void)scan_line(line, true, transparent);
+			_pending_transparent_header = false;
+			return;
+		}
+
+		// a left-edge line at the top level: a comment, declaration or definition.
+		const bool starts_block_comment = line.starts_with("/*");
+		const size_t brace = scan_line(line, true, transparent);
+		_pending_transparent_header = false;
+		if (transparent) {
+			// `extern "C" {` / `namespace foo {`: discarded.
+		} else if (brace != npos) {
+			// keep the prototype; ditch the scope.
+			const std::string_view prototype = trim(line.substr(0, brace));
+			if (!prototype.empty())
+				lines.push_back(prototype);
+		} else if (is_transparent_scope_header(line)) {
+			// `namespace foo` with the `{` on the next line.
+			_pending_transparent_header = true;
+		} else {
+			lines.push_back(line);
+		}
+
+		if (starts_block_comment && _lexical == Lexical::BlockComment)
+			_keep_block_comment = true;
+	}
+
+	void CodeStripper::strip(std::string_view text, std::vector<std::string_view> &lines) {
+		const char *ptr = text.data();
+		const size_t n = text.size();
+		size_t pos = 0;
+
+		while (pos < n) {
+			const char *eol = static_cast<const char *>(memchr(ptr + pos, '\n', n - pos));
+			const size_t end = (eol != nullptr ? eol - ptr : n);
+
+			// trailing whitespace (and CR) doesn't matter to anyone.
+			size_t e = end;
+			while (e > pos && is_blank(ptr[e - 1]))
+				e--;
+
+			strip_line(std::string_view(ptr + pos, e - pos), lines);
+			pos = end + 1;
+		}
+	}
+
+}
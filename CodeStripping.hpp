@@ -0,0 +1,68 @@
+//
+// Strip C/C++ source text down to its outline: the left-edge declarations and comments. This is the engine of the
+// codestripper tool:
+//
+// - keep only comments and function/class prototypes, i.e. only lines which start at left edge.
+// - keep left-edge C multi-line comments.
+// - ditch code scopes: `{ ... }`; a left-edge line which opens a scope is kept up to the `{`.
+// - discard preprocessor statements that are not `#define`.
+// - discard `extern "C" {` and `namespace {` statements: their scopes don't count as code scopes.
+// - ditch empty lines.
+//
+
+#pragma once
+
+#include "Base.hpp"
+
+#include <string_view>
+#include <vector>
+
+
+namespace text_processing {
+
+	// a single pass over the text, one character at a time, tracking the lexical state (code, comment, string or
+	// character literal) and the scope (brace) depth. The surviving lines are produced as views into the text: no
+	// text is copied.
+	//
+	// The state carries over from one `strip()` call to the next, so a text MAY be fed in line-aligned pieces;
+	// call `reset()` before you start on the next source file.
+	class CodeStripper {
+	public:
+		// append the surviving lines of `text` to `lines`. The text MUST outlive `lines`.
+		void strip(std::string_view text, std::vector<std::string_view> &lines);
+
+		void reset(void);
+
+		// the number of scopes currently open (transparent `extern "C"` / `namespace` scopes excluded).
+		size_t scope_depth(void) const {
+			return _depth;
+		}
+
+	protected:
+		enum class Lexical : uint8_t {
+			Code,
+			LineComment,
+			BlockComment,
+			String,
+			Char,
+		};
+
+		// scan one line, updating the lexical state and the scope stack; returns the offset of the first `{` which
+		// opened a scope at depth 0 (or `npos`). `transparent` reports whether that one was an `extern "C"` /
+		// `namespace` scope.
+		size_t scan_line(std::string_view line, bool count_braces, bool &transparent);
+
+		void strip_line(std::string_view line, std::vector<std::string_view> &lines);
+
+		Lexical _lexical = Lexical::Code;
+		// one entry per open `{`: true when it's a transparent `extern "C"` / `namespace` scope.
+		std::vector<bool> _scopes;
+		size_t _depth = 0;
+		bool _keep_block_comment = false;
+		bool _in_preprocessor_line = false;
+		bool _keep_preprocessor_line = false;
+		// `namespace foo` / `extern "C"` without the `{` on the same line: the next line MAY bring it.
+		bool _pending_transparent_header = false;
+	};
+
+}
@@ -0,0 +1,19 @@
+
+#include "CompactSpanList.hpp"
+
+namespace text_processing {
+
+	void CompactSpanList::push_overflow(size_t index, const char *ptr, size_t length) {
+		_spans.push_back(Span{overflow_marker, overflow_marker});
+		_overflow.push_back(Overflow{index, ptr, length});
+	}
+
+	std::string_view CompactSpanList::overflow_span(size_t index) const {
+		auto it = std::lower_bound(_overflow.begin(), _overflow.end(), index, [](const Overflow &o, size_t i) {
+			return o.index < i;
+		});
+		assert(it != _overflow.end() && it->index == index);
+		return std::string_view(it->ptr, it->length);
+	}
+
+}
@@ -0,0 +1,214 @@
+//
+// Compact storage for a list of spans (lines, words, ...) into a single text buffer.
+//
+
+#pragma once
+
+#include "Base.hpp"
+
+#include <cstdint>
+#include <iterator>
+
+
+namespace text_processing {
+
+	// A drop-in alternative for `std::vector<std::string_view>` (`ExtendedFileContent::list`) when all spans point into
+	// the same buffer: each span takes 8 bytes (a 32-bit offset and a 32-bit length) instead of 16.
+	//
+	// The offsets are relative to a 64-bit base per block of 65536 spans, so buffers larger than 4 GB are fine as long
+	// as the spans are added in (roughly) ascending buffer order, as the splitters do. The rare span which doesn't fit
+	// (4 GB+ long, or lying before its block base) is kept in a side table.
+	//
+	// Random access yields `std::string_view`s, hence the usual `for (std::string_view word : list)` loops just work.
+	class CompactSpanList {
+	public:
+		using value_type = std::string_view;
+		using size_type = size_t;
+
+		class const_iterator {
+		public:
+			using iterator_category = std::random_access_iterator_tag;
+			using value_type = std::string_view;
+			using difference_type = ptrdiff_t;
+			using pointer = void;
+			using reference = std::string_view;
+
+			const_iterator() = default;
+			const_iterator(const CompactSpanList *list, size_t index) :
+				_list(list), _index(index) {
+			}
+
+			std::string_view operator*() const {
+				return (*_list)[_index];
+			}
+			std::string_view operator[](difference_type n) const {
+				return (*_list)[_index + n];
+			}
+
+			const_iterator &operator++() {
+				++_index;
+				return *this;
+			}
+			const_iterator operator++(int) {
+				auto rv = *this;
+				++_index;
+				return rv;
+			}
+			const_iterator &operator--() {
+				--_index;
+				return *this;
+			}
+			const_iterator operator--(int) {
+				auto rv = *this;
+				--_index;
+				return rv;
+			}
+			const_iterator &operator+=(difference_type n) {
+				_index += n;
+				return *this;
+			}
+			const_iterator &operator-=(difference_type n) {
+				_index -= n;
+				return *this;
+			}
+			friend const_iterator operator+(const_iterator it, difference_type n) {
+				return it += n;
+			}
+			friend const_iterator operator+(difference_type n, const_iterator it) {
+				return it += n;
+			}
+			friend const_iterator operator-(const_iterator it, difference_type n) {
+				return it -= n;
+			}
+			friend difference_type operator-(const const_iterator &a, const const_iterator &b) {
+				return difference_type(a._index) - difference_type(b._index);
+			}
+			friend bool operator==(const const_iterator &a, const const_iterator &b) {
+				return a._index == b._index;
+			}
+			friend auto operator<=>(const const_iterator &a, const const_iterator &b) {
+				return a._index <=> b._index;
+			}
+
+		protected:
+			const CompactSpanList *_list = nullptr;
+			size_t _index = 0;
+		};
+
+		CompactSpanList() = default;
+		explicit CompactSpanList(const char *base) :
+			_base(base) {
+		}
+
+		// all spans are stored relative to this base pointer: the start of the buffer they point into.
+		// When not set, the first span added sets it.
+		const char *base() const noexcept {
+			return _base;
+		}
+
+		// clear the list and set a new base.
+		void reset(const char *base) {
+			clear();
+			_base = base;
+		}
+
+		void clear() noexcept {
+			_spans.clear();
+			_block_bases.clear();
+			_overflow.clear();
+		}
+
+		void reserve(size_t count) {
+			_spans.reserve(count);
+			_block_bases.reserve((count >> block_shift) + 1);
+		}
+
+		size_t size() const noexcept {
+			return _spans.size();
+		}
+		bool empty() const noexcept {
+			return _spans.empty();
+		}
+
+		void emplace_back(const char *ptr, size_t length) {
+			if (_base == nullptr) {
+				_base = ptr;
+			}
+			const size_t index = _spans.size();
+			const uint64_t offset = uint64_t(ptr - _base);
+			if ((index & block_mask) == 0) {
+				_block_bases.push_back(offset);
+			}
+			const uint64_t block_base = _block_bases.back();
+			if (ptr >= _base && offset >= block_base && offset - block_base < overflow_marker && length < overflow_marker) [[likely]] {
+				_spans.push_back(Span{uint32_t(offset - block_base), uint32_t(length)});
+			} else {
+				push_overflow(index, ptr, length);
+			}
+		}
+
+		void push_back(std::string_view s) {
+			emplace_back(s.data(), s.size());
+		}
+
+		std::string_view operator[](size_t index) const {
+			const Span &span = _spans[index];
+			if (span.offset == overflow_marker && span.length == overflow_marker) [[unlikely]] {
+				return overflow_span(index);
+			}
+			return std::string_view(_base + _block_bases[index >> block_shift] + span.offset, span.length);
+		}
+
+		std::string_view at(size_t index) const {
+			if (index >= _spans.size()) {
+				throw std::out_of_range("CompactSpanList index out of range");
+			}
+			return (*this)[index];
+		}
+
+		std::string_view front() const {
+			return (*this)[0];
+		}
+		std::string_view back() const {
+			return (*this)[_spans.size() - 1];
+		}
+
+		const_iterator begin() const {
+			return const_iterator(this, 0);
+		}
+		const_iterator end() const {
+			return const_iterator(this, _spans.size());
+		}
+
+		// the heap memory held by this list (in bytes)
+		size_t memory_usage() const noexcept {
+			return _spans.capacity() * sizeof(Span) + _block_bases.capacity() * sizeof(uint64_t) + _overflow.capacity() * sizeof(Overflow);
+		}
+
+	protected:
+		struct Span {
+			uint32_t offset;		// relative to the block base
+			uint32_t length;
+		};
+
+		struct Overflow {
+			size_t index;
+			const char *ptr;
+			size_t length;
+		};
+
+		static constexpr const unsigned block_shift = 16;
+		static constexpr const size_t block_mask = (size_t(1) << block_shift) - 1;
+		static constexpr const uint32_t overflow_marker = UINT32_MAX;
+
+		void push_overflow(size_t index, const char *ptr, size_t length);
+		std::string_view overflow_span(size_t index) const;
+
+		const char *_base = nullptr;
+		std::vector<Span> _spans;
+		std::vector<uint64_t> _block_bases;
+		// the spans which don't fit the compact format, in ascending index order.
+		std::vector<Overflow> _overflow;
+	};
+
+}
@@ -8,6 +8,9 @@
 #include "PrivateIntrinsics.hpp"
 
 #include <string.h>
+#include <bit>
+#include <array>
+#include <thread>
 
 
 namespace text_processing {
@@ -68,18 +71,157 @@ namespace text_processing {
 	// for our word + ngram scanners, which are expected to PATCH the action table at runtime to suit their local
 	// needs, i.e. a self-modifying state machine!
 	//
-	void ExtendedFileContent::parseContentAsLines(const FileContentProcessingOptions& options, std::error_code &ec) {
-		ec.clear();
+	// 
+	// UPDATE: the SIMD splitter.
+	// 
+	// It turns out we don't need strcspn/strspn-like behaviour for the *entire* scan after all: the trim + comment
+	// options only ever look at the *edges* of a line, so the only thing we need to hunt for in bulk is the set of
+	// EOL characters (CR, LF, FF and NUL). That's a handful of byte compares per 16/32 byte block, producing a bitmask
+	// of line edges, which we then walk with count-trailing-zeroes. The line edges are trimmed + comment-checked
+	// by `emit_line()`, which only touches a few bytes at either end of each line.
+	//
+	// The actions[] state machine remains as the scalar fallback for non-x86-64 targets; both produce identical
+	// `lines` output.
+	//
+	// UPDATE 2: no more per-call setup.
+	//
+	// The option permutations (`trim_outer_whitespace` x `accept_comment_lines`) are template parameters now: each
+	// splitter is instantiated for all four, so the hot loops carry no option checks at all, and the scalar splitter's
+	// actions[] table is a `constexpr` table per instantiation, i.e. computed at compile time instead of on every call.
+	// The instantiation for the given options + CPU is picked from a table which is set up once.
+	// This serves the many-small-files scenario worried about above.
+	//
+	// The word scanner's actions table is a precomputed `constexpr` table as well: `default_word_actions`.
+	//
+	using line_list = ExtendedFileContent::list;
 
-		// prep the actions table
-		enum Action: uint8_t {
-			noAction = 0,
-			MarkEndOfLine,
-			SkipWhitespace,
-			SkipCommentLine,
-		};
-		Action actions[256] = {MarkEndOfLine, noAction};
-		if (options.trim_outer_whitespace) {
+	// the splitters (and the fused scanner) fill either flavor of span list: `line_list` or `CompactSpanList`.
+	//
+	// A compact list stores its spans relative to the start of the buffer: an empty one is (re)based onto the content
+	// buffer, a non-empty one is appended to, hence must already reference this same buffer.
+	static inline void prepare_compact_list(CompactSpanList &list, const TextBuffer &buf) {
+		if (list.empty()) {
+			list.reset(buf.data());
+		}
+	}
+
+	static inline bool is_line_whitespace(const char c) {
+		return c == ' ' || c == '\t' || c == '\v';
+	}
+
+	// process the raw line [s, e), i.e. sans EOL, as the actions[]-driven splitter would: trim, skip comment lines and empty lines.
+	template <bool Trim, bool Comments, class List>
+	static inline void emit_line(const char *ptr, size_t s, size_t e, List &lines) {
+		if constexpr (Trim) {
+			while (s < e && is_line_whitespace(ptr[s])) {
+				s++;
+			}
+			while (e > s && is_line_whitespace(ptr[e - 1])) {
+				e--;
+			}
+		}
+		if (s == e) {
+			return;
+		}
+		if constexpr (Comments) {
+			if (ptr[s] == '#') {
+				return;
+			}
+		}
+		lines.emplace_back(ptr + s, e - s);
+	}
+
+	// the run-time options flavor, for the fused scanner.
+	template <class List>
+	static inline void emit_line(const char *ptr, size_t s, size_t e, bool trim, bool comments, List &lines) {
+		if (trim) {
+			if (comments)
+				emit_line<true, true>(ptr, s, e, lines);
+			else
+				emit_line<true, false>(ptr, s, e, lines);
+		} else {
+			if (comments)
+				emit_line<false, true>(ptr, s, e, lines);
+			else
+				emit_line<false, false>(ptr, s, e, lines);
+		}
+	}
+
+	// NOTE: the SIMD splitters load full blocks starting at any offset below `l`, hence they will read up to 31 bytes
+	// beyond the content end: that's where our NUL sentinel lives, so we're good.
+	static_assert(TextBuffer::sentinel_size >= 32);
+
+#if defined(TEXT_PROCESSING_HAS_X86_64_SIMD)
+
+	template <bool Trim, bool Comments, class List>
+	static void split_lines_sse2(const char *ptr, size_t l, List &lines) {
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i lf = _mm_set1_epi8('\n');
+		const __m128i ff = _mm_set1_epi8('\f');
+		const __m128i nul = _mm_setzero_si128();
+
+		size_t line_start = 0;
+		for (size_t base = 0; base < l; base += 16) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + base));
+			const __m128i eol = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)), _mm_or_si128(_mm_cmpeq_epi8(v, ff), _mm_cmpeq_epi8(v, nul)));
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(eol));
+			while (mask) {
+				const size_t pos = base + std::countr_zero(mask);
+				mask &= mask - 1;
+				if (pos >= l) {
+					break;
+				}
+				emit_line<Trim, Comments, List>(ptr, line_start, pos, lines);
+				line_start = pos + 1;
+			}
+		}
+		if (line_start < l) {
+			emit_line<Trim, Comments, List>(ptr, line_start, l, lines);
+		}
+	}
+
+	template <bool Trim, bool Comments, class List>
+	TEXT_PROCESSING_TARGET("avx2")
+	static void split_lines_avx2(const char *ptr, size_t l, List &lines) {
+		const __m256i cr = _mm256_set1_epi8('\r');
+		const __m256i lf = _mm256_set1_epi8('\n');
+		const __m256i ff = _mm256_set1_epi8('\f');
+		const __m256i nul = _mm256_setzero_si256();
+
+		size_t line_start = 0;
+		for (size_t base = 0; base < l; base += 32) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + base));
+			const __m256i eol = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)), _mm256_or_si256(_mm256_cmpeq_epi8(v, ff), _mm256_cmpeq_epi8(v, nul)));
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(eol));
+			while (mask) {
+				const size_t pos = base + std::countr_zero(mask);
+				mask &= mask - 1;
+				if (pos >= l) {
+					break;
+				}
+				emit_line<Trim, Comments, List>(ptr, line_start, pos, lines);
+				line_start = pos + 1;
+			}
+		}
+		if (line_start < l) {
+			emit_line<Trim, Comments, List>(ptr, line_start, l, lines);
+		}
+	}
+
+#endif
+
+	enum LineAction: uint8_t {
+		noAction = 0,
+		MarkEndOfLine,
+		SkipWhitespace,
+		SkipCommentLine,
+	};
+
+	template <bool Trim, bool Comments>
+	static consteval std::array<LineAction, 256> make_line_actions(void) {
+		std::array<LineAction, 256> actions{};
+		actions[0] = MarkEndOfLine;
+		if (Trim) {
 			actions['\t'] = SkipWhitespace;
 			actions['\v'] = SkipWhitespace;
 			actions[' '] = SkipWhitespace;
@@ -87,25 +229,27 @@ namespace text_processing {
 		actions['\r'] = MarkEndOfLine;
 		actions['\n'] = MarkEndOfLine;
 		actions['\f'] = MarkEndOfLine;
-		if (options.accept_comment_lines) {
+		if (Comments) {
 			actions['#'] = SkipCommentLine;
 		}
+		return actions;
+	}
 
-		std::string_view d = file_content.content_view();
-		file_content.write_text_edge_sentinel();
+	template <bool Trim, bool Comments>
+	static constexpr std::array<LineAction, 256> line_actions = make_line_actions<Trim, Comments>();
 
-		// apply heuristic to estimate the number of lines that will be found
-		lines.reserve(d.size() / 10);
+	template <bool Trim, bool Comments, class List>
+	[[maybe_unused]] static void split_lines_scalar(const char *ptr, size_t l, List &lines) {
+		constexpr const auto &actions = line_actions<Trim, Comments>;
 
-		// scan the response file:
-		size_t failure_count = 0;
-		const auto* ptr = d.data();
-		for (size_t i = 0, l = d.size(); i < l; ) {
-			uint8_t c = ptr[i++];
+		// NOTE: we index the actions[] table by *unsigned* char: UTF-8 content would otherwise index before the start of the table.
+		const auto* uptr = reinterpret_cast<const uint8_t *>(ptr);
+		for (size_t i = 0; i < l; ) {
+			uint8_t c = uptr[i++];
 			switch (actions[c]) {
 			case SkipWhitespace:
-				while (is_blank(ptr[i])) {
-					i--;
+				while (actions[uptr[i]] == SkipWhitespace) {
+					i++;
 				}
 				continue;
 
@@ -114,7 +258,7 @@ namespace text_processing {
 				continue;
 
 			case SkipCommentLine:
-				while (actions[ptr[i++]] != MarkEndOfLine) {
+				while (actions[uptr[i++]] != MarkEndOfLine) {
 					;
 				}
 				continue;
@@ -123,28 +267,26 @@ namespace text_processing {
 			default:
 				auto start = i - 1;
 				// path MAY have INTERNAL whitespace: find the terminating CR/LF/NUL
-				while (actions[ptr[i++]] != MarkEndOfLine) {
+				while (actions[uptr[i++]] != MarkEndOfLine) {
 					;
 				}
 				const auto ei = i;
-				// but trim off trailing whitespace!
+				// step back onto the EOL and trim off trailing whitespace!
 				// 
-				//if (options.trim_outer_whitespace) {    --> only then does state `SkipWhitespace` exist in the actions table.
-					while (actions[ptr[--i]] == SkipWhitespace) {
-						;
-					}
-					i++;
-				//}
+				// only when `trim` is set does state `SkipWhitespace` exist in the actions table.
+				--i;
+				while (actions[uptr[i - 1]] == SkipWhitespace) {
+					--i;
+				}
 
-				std::string_view line(ptr + start, i - start);
-				assert(!line.empty());
+				assert(i > start);
 
-				lines.push_back(line);
+				lines.emplace_back(ptr + start, i - start);
 
-				// small aid for CRLF line terminations in files: ptr[i-1] is probably the CR, so we might speed things up
-				// by quickly checking if ptr[i] is a LF:
+				// small aid for CRLF line terminations in files: ptr[ei-1] is probably the CR, so we might speed things up
+				// by quickly checking if ptr[ei] is a LF:
 				i = ei;
-				if (actions[ptr[i]] == MarkEndOfLine) {
+				if (actions[uptr[i]] == MarkEndOfLine) {
 					++i;
 				}
 				continue;
@@ -152,206 +294,970 @@ namespace text_processing {
 		}
 	}
 
+	template <class List>
+	using split_lines_f = void (*)(const char *ptr, size_t l, List &lines);
 
-	void ExtendedFileContent::parseContentAsParagraphs(const FileContentProcessingOptions& options, std::error_code &ec) {
-		ec.clear();
+	template <bool Trim, bool Comments, class List>
+	static split_lines_f<List> select_line_splitter(void) {
+#if defined(TEXT_PROCESSING_HAS_X86_64_SIMD)
+		if (cpu_has_avx2()) {
+			return split_lines_avx2<Trim, Comments, List>;
+		}
+		return split_lines_sse2<Trim, Comments, List>;
+#else
+		return split_lines_scalar<Trim, Comments, List>;
+#endif
+	}
 
-		// prep the actions table
-		enum Action: uint8_t {
-			noAction = 0,
-			MarkEndOfLine,
-			MarkEndOfParagraph,
-			SkipWhitespace,
+	// split [ptr, ptr+l) into `lines`, using the splitter for the given options + CPU.
+	template <class List>
+	static void split_lines(const char *ptr, size_t l, const FileContentProcessingOptions& options, List &lines) {
+		// indexed by [trim_outer_whitespace][accept_comment_lines]
+		static const split_lines_f<List> splitters[2][2] = {
+			{ select_line_splitter<false, false, List>(), select_line_splitter<false, true, List>() },
+			{ select_line_splitter<true, false, List>(), select_line_splitter<true, true, List>() },
 		};
-		Action actions[256] = {MarkEndOfLine, noAction};
-		if (options.trim_outer_whitespace || options.dedent_lines || options.contract_lines_in_paragraph) {
-			actions['\t'] = SkipWhitespace;
-			actions['\v'] = SkipWhitespace;
-			actions[' '] = SkipWhitespace;
+
+		splitters[options.trim_outer_whitespace][options.accept_comment_lines](ptr, l, lines);
+	}
+
+	// returns the position of the first EOL character (CR, LF, FF, NUL) at or beyond `i`. The NUL sentinel guarantees termination.
+	static inline size_t find_eol(const char *ptr, size_t i) {
+#if defined(TEXT_PROCESSING_HAS_X86_64_SIMD)
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i lf = _mm_set1_epi8('\n');
+		const __m128i ff = _mm_set1_epi8('\f');
+		const __m128i nul = _mm_setzero_si128();
+		for (;;) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + i));
+			const __m128i eol = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)), _mm_or_si128(_mm_cmpeq_epi8(v, ff), _mm_cmpeq_epi8(v, nul)));
+			const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(eol));
+			if (mask) {
+				return i + std::countr_zero(mask);
+			}
+			i += 16;
 		}
-		actions['\r'] = MarkEndOfLine;
-		actions['\n'] = MarkEndOfLine;
-		actions['\f'] = MarkEndOfLine;
+#else
+		for (;;) {
+			switch (ptr[i]) {
+			case '\r':
+			case '\n':
+			case '\f':
+			case 0:
+				return i;
 
-		bool we_are_rewriting_the_text = (options.dedent_lines || options.contract_lines_in_paragraph || options.cleanup_diacritics || options.cleanup_punctuation || options.contract_hyphenated_words_at_EOL || options.unicode_normalization);
+			default:
+				i++;
+				continue;
+			}
+		}
+#endif
+	}
 
-		std::string_view d = file_content.content_view();
-		file_content.write_text_edge_sentinel();
-
-		// see if we have enough scratch space for the content rewriting that's going to happen.
-		// All options actually *reduce* the content size, so estimating the cost at 'source text length'
-		// is safe & swift!
-		std::string_view target = file_content.available_space_view();
-		if (target.size() < file_content.content_length() + TextBuffer::sentinel_size) {
-			LIBASSERT_ASSERT(false, "run-time should of course never get here, but there ARE TextBuffer usage scenarios where this COULD happen, so we must check. And you're better off we actually did!");
-			ec = std::make_error_code(std::errc::no_buffer_space);
-			return;
+	// The span list reservations:
+	//
+	// by default we apply heuristics (~10 bytes per line, ~100 bytes per paragraph), which are way off for some content:
+	// a list of long paths (~120 bytes per line) gets over-reserved 12x, while a word list (~8 bytes per line) gets
+	// under-reserved and reallocates (i.e. copies) its list several times over.
+	//
+	// With `FileContentProcessingOptions::exact_reservation` set, we count instead: a vectorized pre-pass over the
+	// content, which produces the number of non-empty lines and the number of blank lines & form feeds, i.e. the
+	// (potential) paragraph breaks. That is the exact line count, unless trimming or comment lines make lines
+	// disappear; in any case it's an upper bound. The pre-pass runs at memory bandwidth, which is a lot cheaper than
+	// a few rounds of reallocating a multi-GB list.
+	struct LineCounts {
+		size_t nonempty_lines = 0;
+		size_t paragraph_breaks = 0;
+	};
+
+	static inline bool is_eol_char(const char c) {
+		return c == '\r' || c == '\n' || c == '\f' || c == 0;
+	}
+
+	// the EOL characters in a block of 32 bytes, one bit per byte.
+	struct EolMasks {
+		uint32_t eol;			// CR, LF, FF or NUL: as for the splitters.
+		uint32_t cr;
+		uint32_t lf;
+		uint32_t ff;
+	};
+
+	// count, 32 bytes at a time:
+	// - the non-empty lines: the EOL characters not preceded by another EOL character, plus the last line, if it's not terminated;
+	// - the blank lines: the line terminators preceded by another EOL character, where a CRLF pair is one terminator;
+	//   a form feed terminating a non-empty line adds a paragraph break as well.
+	//
+	// The SIMD flavors each write out the loop over the blocks themselves, so their mask function is inlined with the
+	// instruction set it's compiled for.
+	//
+	// NOTE: like the SIMD splitters, these read up to 31 bytes beyond the content end, i.e. into the sentinel.
+	struct LineCounter {
+		LineCounts counts;
+		uint32_t prev_eol = 1;			// the content start acts as a line start
+		uint32_t prev_cr = 0;
+
+		// `left`: the number of content bytes from the start of this block onwards.
+		void add(EolMasks m, size_t left) {
+			if (left < 32) {
+				const uint32_t valid = (uint32_t(1) << left) - 1;
+				m.eol &= valid;
+				m.cr &= valid;
+				m.lf &= valid;
+				m.ff &= valid;
+			}
+			const uint32_t eol_before = (m.eol << 1) | prev_eol;
+			const uint32_t terminators = m.eol & ~(m.lf & ((m.cr << 1) | prev_cr));
+			counts.nonempty_lines += std::popcount(m.eol & ~eol_before);
+			counts.paragraph_breaks += std::popcount(terminators & eol_before) + std::popcount(m.ff & ~eol_before);
+			prev_eol = m.eol >> 31;
+			prev_cr = m.cr >> 31;
 		}
 
-		// apply heuristic to estimate the number of paragraphs that will be found
-		this->paragraphs.reserve(d.size() / 100);
-
-		// scan the response file:
-		// outer loop implies we're at a *paragraph edge* ==> paragraph start.
-		size_t failure_count = 0;
-		size_t paragraph_start_idx = 0;
-		size_t paragraph_dedent_start_idx = 0;
-		size_t paragraph_dedent_length = 0;
-		const auto* ptr = d.data();
-		//std::string_view::iterator dst_it = target.begin();
-		char* dst = const_cast<char*>(target.data());
-		for (size_t i = 0, l = d.size(); i < l; ) {
-			uint8_t c = ptr[i++];
-			switch (actions[c]) {
-			case SkipWhitespace:
-				while (is_blank(ptr[i])) {
-					i--;
+		LineCounts finish(const char *ptr, size_t l) {
+			if (l > 0 && !is_eol_char(ptr[l - 1])) {
+				counts.nonempty_lines++;
+			}
+			return counts;
+		}
+	};
+
+	[[maybe_unused]] static LineCounts count_lines_scalar(const char *ptr, size_t l) {
+		LineCounts counts;
+		bool prev_eol = true;
+		for (size_t i = 0; i < l; i++) {
+			const char c = ptr[i];
+			const bool eol = is_eol_char(c);
+			if (eol) {
+				if (!prev_eol) {
+					counts.nonempty_lines++;
+					// a form feed ending a line breaks the paragraph too.
+					if (c == '\f')
+						counts.paragraph_breaks++;
+				} else if (!(c == '\n' && i > 0 && ptr[i - 1] == '\r')) {
+					counts.paragraph_breaks++;
 				}
-				continue;
+			}
+			prev_eol = eol;
+		}
+		if (!prev_eol) {
+			counts.nonempty_lines++;
+		}
+		return counts;
+	}
 
-			case MarkEndOfLine:
-				// end-of-line ~ empty line. ignore; reset paragraph start markers.
-				paragraph_start_idx = i;
-				paragraph_dedent_start_idx = i;
-				continue;
+#if defined(TEXT_PROCESSING_HAS_X86_64_SIMD)
 
-			[[likely]] case noAction:
-			default:
-				auto start = i - 1;
-				paragraph_dedent_length = start - paragraph_dedent_start_idx;
+	static inline EolMasks eol_masks_sse2(const char *ptr) {
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i lf = _mm_set1_epi8('\n');
+		const __m128i ff = _mm_set1_epi8('\f');
+		const __m128i nul = _mm_setzero_si128();
 
-				*dst++ = c;
+		EolMasks m{};
+		for (int half = 0; half < 2; half++) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 16 * half));
+			const __m128i is_cr = _mm_cmpeq_epi8(v, cr);
+			const __m128i is_lf = _mm_cmpeq_epi8(v, lf);
+			const __m128i is_ff = _mm_cmpeq_epi8(v, ff);
+			const __m128i eol = _mm_or_si128(_mm_or_si128(is_cr, is_lf), _mm_or_si128(is_ff, _mm_cmpeq_epi8(v, nul)));
+			const unsigned shift = 16 * half;
+			m.eol |= uint32_t(_mm_movemask_epi8(eol)) << shift;
+			m.cr |= uint32_t(_mm_movemask_epi8(is_cr)) << shift;
+			m.lf |= uint32_t(_mm_movemask_epi8(is_lf)) << shift;
+			m.ff |= uint32_t(_mm_movemask_epi8(is_ff)) << shift;
+		}
+		return m;
+	}
 
-				// rewrite the new paragraph following the options.
-				// 
-				// source text path MAY have INTERNAL whitespace: find the terminating (double) CR/LF/NUL:
-				// paragraphs are marked by double-newline a la MarkDown, but the tough part is various
-				// files can have Classic MAC CR+CR, or UNIX LF+LF or MSDOS/Win CR/LF + CR/LF line endings...
-				// or a mix thereof. So we better base this 'double newline marker' approach off
-				// the rewritten content?
-				//
-				// We're safe scanning multiple NULs at the end of the source text as we have written
-				// a `sentinel_size`-wide chunk of NULs, where `sentinel_size > 2`, so we're
-				// still within safe buffer space bounds while detecting a 'paragraph end' the old-fashioned way.
-				// Meanshwile, we have checked our scratch space has sufficient space reserved for a similar
-				// long NUL-sentinel, so either way we won't be barging off into unallocated memory...
+	TEXT_PROCESSING_TARGET("avx2")
+	static inline EolMasks eol_masks_avx2(const char *ptr) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+		const __m256i is_cr = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'));
+		const __m256i is_lf = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+		const __m256i is_ff = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\f'));
+		const __m256i eol = _mm256_or_si256(_mm256_or_si256(is_cr, is_lf), _mm256_or_si256(is_ff, _mm256_cmpeq_epi8(v, _mm256_setzero_si256())));
+		return EolMasks{
+			uint32_t(_mm256_movemask_epi8(eol)),
+			uint32_t(_mm256_movemask_epi8(is_cr)),
+			uint32_t(_mm256_movemask_epi8(is_lf)),
+			uint32_t(_mm256_movemask_epi8(is_ff)),
+		};
+	}
 
-				// we're inside a *line* (which we will rewrite), just beyond the initial indent ('dedent' option).
+	static LineCounts count_lines_sse2(const char *ptr, size_t l) {
+		LineCounter counter;
+		for (size_t base = 0; base < l; base += 32) {
+			counter.add(eol_masks_sse2(ptr + base), l - base);
+		}
+		return counter.finish(ptr, l);
+	}
 
-				// 0x00ad   Soft hyphen is typically printed as a hyphen (-) in terminals.
+	TEXT_PROCESSING_TARGET("avx2")
+	static LineCounts count_lines_avx2(const char *ptr, size_t l) {
+		LineCounter counter;
+		for (size_t base = 0; base < l; base += 32) {
+			counter.add(eol_masks_avx2(ptr + base), l - base);
+		}
+		return counter.finish(ptr, l);
+	}
 
+#endif
 
-				bool we_are_rewriting_the_text = (options.dedent_lines || options.contract_lines_in_paragraph || options.cleanup_diacritics || options.cleanup_punctuation || options.contract_hyphenated_words_at_EOL || options.unicode_normalization);
+	static LineCounts count_lines(const char *ptr, size_t l) {
+		using count_lines_f = LineCounts (*)(const char *ptr, size_t l);
+		static const count_lines_f counter = [] () -> count_lines_f {
+#if defined(TEXT_PROCESSING_HAS_X86_64_SIMD)
+			if (cpu_has_avx2()) {
+				return count_lines_avx2;
+			}
+			return count_lines_sse2;
+#else
+			return count_lines_scalar;
+#endif
+		}();
+		return counter(ptr, l);
+	}
 
-#if 0
+	struct SpanCountEstimate {
+		size_t lines;
+		size_t paragraphs;
+	};
 
-				// &npsp; &thinsp; etc are treated as normal spaces
-				std::string get_dec_entity(std::size_t cp) {
-					std::string value;
-					if (cp <= 0x7Ful) { // 127, ascii
-						if (cp < 32) { // Treat initial 32 ASCII characters as spaces
-							value.push_back(' ');
-							return value;
-						}
-						value.push_back((unsigned char)cp);
-					} else if (cp <= 0x7FFul) { // 2047, 2 bytes
-						if (cp == 160) { // nbsp
-							value.push_back(' ');
-							return value;
-						} else if (cp == 173) { // soft hyphen
-							return value;
-						} else if (cp >= 8194 and cp <= 8202) { // thinsp, ensp, emsp, etc
-							value.push_back(' ');
-							return value;
-						} else if (cp == 8203) { // zwsp
-							return value;
-						} else if (cp == 9287) { // mediumsp
-							value.push_back(' ');
-							return value;
-						}
-						value.push_back((unsigned char)(0xC0 | (cp >> 6)));
-						value.push_back((unsigned char)(0x80 | (cp & 0x3F)));
-					} else if (cp <= 0xFFFFul) { // 65535, 3 bytes
-						value.push_back((unsigned char)(0xE0 | (cp >> 12)));
-						value.push_back((unsigned char)(0x80 | ((cp >> 6) & 0x3F)));
-						value.push_back((unsigned char)(0x80 | (cp & 0x3F)));
-					} else if (cp <= 0x10FFFFul) { // 1114111, 4 bytes
-						value.push_back((unsigned char)(0xF0 | (cp >> 18)));
-						value.push_back((unsigned char)(0x80 | ((cp >>12) & 0x3F)));
-						value.push_back((unsigned char)(0x80 | ((cp >> 6) & 0x3F)));
-						value.push_back((unsigned char)(0x80 | (cp & 0x3F)));
-					}
-					return value;
+	// the number of lines and paragraphs to reserve for. The content sentinel must be in place.
+	static SpanCountEstimate estimate_span_counts(std::string_view d, const FileContentProcessingOptions& options) {
+		if (!options.exact_reservation) {
+			// apply heuristic to estimate the number of lines & paragraphs that will be found
+			return {d.size() / 10, d.size() / 100};
+		}
+		const LineCounts counts = count_lines(d.data(), d.size());
+		// every paragraph takes at least one non-empty line and is followed by a break, except the last one.
+		return {counts.nonempty_lines, std::min(counts.nonempty_lines, counts.paragraph_breaks + 1)};
+	}
+
+	// parallel splitting:
+	//
+	// for a (multi-GB) buffer, the line and word splitters can be run on several cores: the content is cut into
+	// `thread_count` chunks, right after the first EOL character at or beyond each 1/N-th of the content, so no line
+	// (and hence no word) is ever cut in two. A CRLF pair may be cut, but the LF which then starts the next chunk only
+	// 'terminates' an empty line, which is no line at all.
+	//
+	// Each chunk is split into a list of its own; these are appended to the output list in order: a plain copy of
+	// the span lists, which is small fry compared to the scanning of the text they index.
+	//
+	// As each chunk ends with an EOL character and the last one ends at the content end, every chunk is terminated
+	// as the splitters require, and the SIMD splitters' overshoot reads stay within the buffer.
+	static constexpr const size_t min_parallel_chunk_size = 4 * 1024 * 1024;
+
+	static unsigned split_thread_count_for(size_t l, const FileContentProcessingOptions& options) {
+		unsigned n = options.split_thread_count;
+		if (n == 0)
+			n = std::max(1U, std::thread::hardware_concurrency());
+		// don't bother for small content: the thread start-up would cost more than it saves.
+		return unsigned(std::min<size_t>(n, std::max<size_t>(l / min_parallel_chunk_size, 1)));
+	}
+
+	// `split_chunk(std::string_view chunk, List &part)` splits a single chunk.
+	template <class List, class SplitChunk>
+	static void split_in_parallel(std::string_view d, unsigned thread_count, List &out, const SplitChunk &split_chunk) {
+		const char *ptr = d.data();
+		const size_t l = d.size();
+
+		std::vector<size_t> bounds(thread_count + 1);
+		bounds[0] = 0;
+		for (unsigned t = 1; t < thread_count; t++) {
+			const size_t target = std::max(bounds[t - 1], l / thread_count * t);
+			bounds[t] = std::min(find_eol(ptr, target) + 1, l);
+		}
+		bounds[thread_count] = l;
+
+		std::vector<List> parts(thread_count);
+		auto work = [&](unsigned t) {
+			split_chunk(std::string_view(ptr + bounds[t], bounds[t + 1] - bounds[t]), parts[t]);
+		};
+		{
+			std::vector<std::jthread> workers;
+			workers.reserve(thread_count - 1);
+			for (unsigned t = 1; t < thread_count; t++) {
+				try {
+					workers.emplace_back(work, t);
+				} catch (const std::system_error &) {
+					// cannot start another thread: do this chunk ourselves.
+					work(t);
 				}
+			}
+			work(0);
+			// the jthreads join on destruction.
+		}
 
+		size_t total = out.size();
+		for (const auto &part : parts) {
+			total += part.size();
+		}
+		out.reserve(total);
+		for (const auto &part : parts) {
+			if constexpr (std::is_same_v<List, line_list>) {
+				out.insert(out.end(), part.begin(), part.end());
+			} else {
+				for (std::string_view span : part) {
+					out.push_back(span);
+				}
+			}
+		}
+	}
 
+	void ExtendedFileContent::parseContentAsLines(const FileContentProcessingOptions& options, std::error_code &ec) {
+		ec.clear();
 
-			} while (((*in >= 0x20) && (*in <= 0x7F)) || (*in == 0x09) || (*in == 0x0a));
+		std::string_view d = file_content.content_view();
+		file_content.ensure_text_edge_sentinel();
 
-			=====================
-				Argument Substitution
-				=====================
+		const unsigned thread_count = split_thread_count_for(d.size(), options);
+		if (thread_count > 1) {
+			auto split_chunk = [&options](std::string_view chunk, auto &part) {
+				part.reserve(estimate_span_counts(chunk, options).lines);
+				split_lines(chunk.data(), chunk.size(), options, part);
+			};
+			if (options.compact_spans) {
+				prepare_compact_list(compact_lines, file_content);
+				split_in_parallel(d, thread_count, compact_lines, split_chunk);
+			} else {
+				split_in_parallel(d, thread_count, lines, split_chunk);
+			}
+			return;
+		}
 
-				Before a rule can be matched, any %-variables must be substituted. These are defined
-				in the same configuration file as the rules, and look something like:
-			%W=[\w\-]++
-				or:
-				%D=//ldml/numbers/defaultNumberingSystem
+		const size_t expected_count = estimate_span_counts(d, options).lines;
+		if (options.compact_spans) {
+			prepare_compact_list(compact_lines, file_content);
+			compact_lines.reserve(compact_lines.size() + expected_count);
+			split_lines(d.data(), d.size(), options, compact_lines);
+		} else {
+			lines.reserve(lines.size() + expected_count);
+			split_lines(d.data(), d.size(), options, lines);
+		}
+	}
 
-				The first case can be thought of as just a snippet of regular expression (in this case
-				something that matches hyphen separated words) and, importantly, here '[' and ']' are
-				treated as regular expression metacharacters. These arguments are static and wil be
-				substituted exactly as-is into the regular expression to be used for matching.
+	// incremental splitting, e.g. while the content is still being loaded: see the pipelined `processFileEx()`.
+	void ExtendedFileContent::parseContentRangeAsLines(size_t start, size_t end, const FileContentProcessingOptions& options, std::error_code &ec) {
+		ec.clear();
+		assert(start <= end);
 
-				The second case (used exactly once) is a dynamic argument which references a CLDR value
-				in the set of data being transformed. This is simply indicated by the fact that it starts
-				with '//'. This path is resolved and the value is substituted just prior to matching.
+		const char *ptr = file_content.data() + start;
+		if (options.compact_spans) {
+			prepare_compact_list(compact_lines, file_content);
+			split_lines(ptr, end - start, options, compact_lines);
+		} else {
+			split_lines(ptr, end - start, options, lines);
+		}
+	}
 
-				Variable names are limited to a single upper-case letter (A-Z).
 
+	// parseContentAsParagraphs():
+	//
+	// a paragraph is a run of non-empty lines; paragraphs are separated by one or more empty (whitespace-only) lines
+	// or a form feed. Classic Mac CR, UNIX LF and MSDOS/Windows CRLF line endings, or any mix thereof, are accepted:
+	// a CRLF pair counts as a single line end, any other CR or LF as one line end each.
+	//
+	// When none of the rewriting options is set, each paragraph is a view into the source text, running from the start
+	// of its first line to the end of its last line (trimmed when `trim_outer_whitespace` is set): zero copying.
+	//
+	// Otherwise the paragraphs are rewritten into the TextBuffer scratch space, NUL-terminated, in a single pass:
+	//
+	// - all line endings are normalized to LF;
+	// - `trim_outer_whitespace`: the leading whitespace of the paragraph and the trailing whitespace of each line is removed;
+	// - `dedent_lines`: the indent of the first line is removed from each line (as far as they carry that much whitespace);
+	// - `contract_lines_in_paragraph`: the lines are trimmed and joined by a single space, i.e. each paragraph becomes
+	//   a single line of text;
+	// - `contract_hyphenated_words_at_EOL`: a word hyphenated at the end of a line ('-' or soft hyphen U+00AD) is joined
+	//   with its remainder at the start of the next line, when that one starts with a lowercase letter (or any non-ASCII
+	//   character): "hyphen-\nation" --> "hyphenation".
+	//
+	// The cleanup/normalization options currently only trigger the rewrite; their transformations are not implemented yet.
+	//
+	// As all options *reduce* the content size, the rewrite needs no more scratch space than the source text size plus
+	// a sentinel.
 
+	static inline bool is_hyphen_continuation(const uint8_t c) {
+		return (c >= 'a' && c <= 'z') || c >= 0x80;
+	}
 
+	static inline bool is_hyphenated_word_end(const char *ptr, size_t s, size_t e, size_t &hyphen_length) {
+		const auto *uptr = reinterpret_cast<const uint8_t *>(ptr);
+		if (e >= s + 2 && uptr[e - 1] == '-' && (isalnum(uptr[e - 2]) || uptr[e - 2] >= 0x80)) {
+			hyphen_length = 1;
+			return true;
+		}
+		// U+00AD SOFT HYPHEN
+		if (e >= s + 3 && uptr[e - 2] == 0xC2 && uptr[e - 1] == 0xAD) {
+			hyphen_length = 2;
+			return true;
+		}
+		return false;
+	}
 
-#endif
+	// collects the paragraphs line by line: feed it each line, sans EOL, with `add_line()`.
+	//
+	// This is shared by `parseContentAsParagraphs()` and the fused multi-mode scanner in `parseContent()`.
+	class ParagraphBuilder {
+	public:
+		ParagraphBuilder(const char *ptr, const FileContentProcessingOptions& options, line_list &paragraphs) :
+			ptr(ptr),
+			options(options),
+			paragraphs(paragraphs),
+			we_are_rewriting_the_text(options.dedent_lines || options.contract_lines_in_paragraph || options.cleanup_diacritics || options.cleanup_punctuation || options.contract_hyphenated_words_at_EOL || options.unicode_normalization),
+			trim(options.trim_outer_whitespace),
+			contract(options.contract_lines_in_paragraph) {
+		}
 
-				while (actions[ptr[i++]] != MarkEndOfLine) {
-					;
+		// sets up the scratch space for the rewrite, if we need one, and reserves room for `expected_count` paragraphs.
+		void begin(TextBuffer &buffer, size_t expected_count, std::error_code &ec) {
+			if (we_are_rewriting_the_text) {
+				// see if we have enough scratch space for the content rewriting that's going to happen.
+				// All options actually *reduce* the content size, so estimating the cost at 'source text length'
+				// is safe & swift!
+				std::string_view target = buffer.available_space_view();
+				if (target.size() < buffer.content_length() + TextBuffer::sentinel_size) {
+					LIBASSERT_ASSERT(false, "run-time should of course never get here, but there ARE TextBuffer usage scenarios where this COULD happen, so we must check. And you're better off we actually did!");
+					ec = std::make_error_code(std::errc::no_buffer_space);
+					return;
 				}
-				const auto ei = i;
-				// but trim off trailing whitespace!
-				// 
-				//if (options.trim_outer_whitespace) {    --> only then does state `SkipWhitespace` exist in the actions table.
-				while (actions[ptr[--i]] == SkipWhitespace) {
-					;
-				}
-				i++;
-				//}
+				dst_start = const_cast<char *>(target.data());
+				dst = dst_start;
+			}
 
-				std::string_view line(ptr + start, i - start);
-				assert(!line.empty());
+			paragraphs.clear();
+			paragraphs.reserve(expected_count);
+		}
 
-				lines.push_back(line);
+		// the line is [ls, le); `form_feed` signals the line was terminated by a form feed, which ends the paragraph.
+		inline void add_line(size_t ls, size_t le, bool form_feed) {
+			// the non-whitespace part of the line is [s, e)
+			size_t s = ls;
+			while (s < le && is_line_whitespace(ptr[s])) {
+				s++;
+			}
+			if (s == le) {
+				// empty line ~ paragraph edge.
+				end_paragraph();
+				return;
+			}
+			size_t e = le;
+			while (is_line_whitespace(ptr[e - 1])) {
+				e--;
+			}
 
-				// small aid for CRLF line terminations in files: ptr[i-1] is probably the CR, so we might speed things up
-				// by quickly checking if ptr[i] is a LF:
-				i = ei;
-				if (actions[ptr[i]] == MarkEndOfLine) {
-					++i;
+			if (!we_are_rewriting_the_text) {
+				if (!in_paragraph) {
+					in_paragraph = true;
+					src_start = (trim ? s : ls);
+				}
+				src_end = (trim ? e : le);
+			} else {
+				// what we keep of this line:
+				size_t a = ls;
+				size_t b = (trim || contract ? e : le);
+				if (!in_paragraph) {
+					in_paragraph = true;
+					dst_paragraph = dst;
+					hyphen_at = nullptr;
+					dedent = s - ls;
+					if (trim || contract || options.dedent_lines) {
+						a = s;
+					}
+				} else {
+					if (contract) {
+						a = s;
+					} else if (options.dedent_lines) {
+						a = std::min(s, ls + dedent);
+					}
+
+					if (hyphen_at && is_hyphen_continuation(ptr[s])) {
+						// join the hyphenated word: drop the hyphen and the next line's indent.
+						dst = hyphen_at;
+						a = s;
+					} else {
+						*dst++ = (contract ? ' ' : '\n');
+					}
 				}
+
+				size_t hyphen_length;
+				hyphen_at = nullptr;
+				if (options.contract_hyphenated_words_at_EOL && is_hyphenated_word_end(ptr, s, e, hyphen_length)) {
+					hyphen_at = dst + (e - a) - hyphen_length;
+				}
+
+				memcpy(dst, ptr + a, b - a);
+				dst += b - a;
+			}
+
+			if (form_feed) {
+				end_paragraph();
+			}
+		}
+
+		void finish(TextBuffer &buffer) {
+			end_paragraph();
+
+			if (we_are_rewriting_the_text) {
+				// plant a sentinel after the last paragraph and claim the scratch space we used.
+				//
+				// Every paragraph ends with a NUL, which doubles as the first byte of that sentinel. That NUL replaces the
+				// paragraph's terminator in the source text, except for a last paragraph without one: then it's the one
+				// byte we write beyond the source text length, so the sentinel MUST be one byte shorter to stay within
+				// the `content_length() + sentinel_size` scratch space we checked for in `begin()`.
+				memset(dst, 0, (dst > dst_start ? TextBuffer::sentinel_size - 1 : TextBuffer::sentinel_size));
+				buffer.mark_this_space_as_occupied(dst - dst_start);
+			}
+		}
+
+	protected:
+		inline void end_paragraph() {
+			if (!in_paragraph)
+				return;
+			in_paragraph = false;
+			if (we_are_rewriting_the_text) {
+				paragraphs.emplace_back(dst_paragraph, dst - dst_paragraph);
+				*dst++ = 0;
+			} else {
+				paragraphs.emplace_back(ptr + src_start, src_end - src_start);
+			}
+		}
+
+		const char *ptr;
+		const FileContentProcessingOptions& options;
+		line_list &paragraphs;
+		const bool we_are_rewriting_the_text;
+		const bool trim;
+		const bool contract;
+
+		char *dst_start = nullptr;
+		char *dst = nullptr;
+
+		// the paragraph being collected:
+		bool in_paragraph = false;
+		size_t src_start = 0;			// zero-copy mode: the paragraph in the source text is [src_start, src_end)
+		size_t src_end = 0;
+		char *dst_paragraph = nullptr;	// rewrite mode: the paragraph in the scratch space starts here
+		size_t dedent = 0;
+		char *hyphen_at = nullptr;		// rewrite mode: the position of a trailing hyphen in the previous line, if any
+	};
+
+	// find the end of the line starting at `i`: returns the line end and moves `i` beyond the EOL, where a CRLF pair counts as a single EOL.
+	static inline size_t next_line(const char *ptr, size_t l, size_t &i) {
+		const size_t le = std::min(find_eol(ptr, i), l);
+		i = le;
+		if (i < l) {
+			i += (ptr[i] == '\r' && ptr[i + 1] == '\n') ? 2 : 1;
+		}
+		return le;
+	}
+
+	void ExtendedFileContent::parseContentAsParagraphs(const FileContentProcessingOptions& options, std::error_code &ec) {
+		ec.clear();
+
+		std::string_view d = file_content.content_view();
+		file_content.ensure_text_edge_sentinel();
+
+		const auto *ptr = d.data();
+		const size_t l = d.size();
+
+		ParagraphBuilder builder(ptr, options, paragraphs);
+		if (builder.begin(file_content, estimate_span_counts(d, options).paragraphs, ec), ec) {
+			return;
+		}
+
+		size_t i = 0;
+		while (i < l) {
+			const size_t ls = i;
+			const size_t le = next_line(ptr, l, i);
+			builder.add_line(ls, le, ptr[le] == '\f');
+		}
+		builder.finish(file_content);
+	}
+
+	// parseContentAsWords():
+	//
+	// the actions[] state machine in its 'patched at run-time' incarnation: the ASCII part of the table decides
+	// the fate of the vast majority of bytes in a single lookup, while all UTF-8 lead bytes map to `Utf8Lead`,
+	// which makes us decode the sequence and classify the code point instead.
+	//
+	// A word is a run of word characters, where `WordJoiner` characters (apostrophes, hyphens, ...) are accepted
+	// *inside* a word only, i.e. when sandwiched between word characters: "don't", "e-mail".
+	// CJK ideographs and kana are not whitespace-separated in running text, so each of those is produced as a word
+	// of its own. Invalid UTF-8 is treated as legacy 8-bit text: one word character per byte.
+	//
+	// We never split a valid UTF-8 sequence, so all produced word views are valid UTF-8 when the input was.
+	//
+	enum WordAction: uint8_t {
+		WordSeparator = 0,
+		WordCharacter,
+		WordJoiner,
+		WordIdeograph,		// a word all by itself
+		Utf8Lead,
+	};
+
+	struct WordActionTable {
+		WordAction actions[256];
+	};
+
+	static consteval WordActionTable make_default_word_actions(void) {
+		WordActionTable table{};
+		auto &actions = table.actions;
+		for (int c = 0; c < 256; c++) {
+			if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_') {
+				actions[c] = WordCharacter;
+			} else if (c >= 0x80) {
+				actions[c] = Utf8Lead;
+			} else {
+				actions[c] = WordSeparator;
+			}
+		}
+		actions['\''] = WordJoiner;
+		actions['-'] = WordJoiner;
+		return table;
+	}
+
+	static constexpr WordActionTable default_word_actions = make_default_word_actions();
+
+	// decode the UTF-8 sequence at `p` and classify it. Returns the classification and the sequence length.
+	//
+	// NOTE: we may look ahead up to 3 bytes: the NUL sentinel (or the EOL ending the line) terminates any
+	// incomplete sequence at the end of the scanned range.
+	static inline std::pair<WordAction, size_t> classify_utf8(const uint8_t *p) {
+		const uint32_t c = p[0];
+		if (c < 0xC2 || c > 0xF4) {
+			// stray continuation byte, overlong lead or out of Unicode range: legacy 8-bit text.
+			return {WordCharacter, 1};
+		}
+		const size_t n = (c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4);
+		uint32_t cp = c & (0x7F >> n);
+		for (size_t k = 1; k < n; k++) {
+			if ((p[k] & 0xC0) != 0x80) {
+				return {WordCharacter, 1};
+			}
+			cp = (cp << 6) | (p[k] & 0x3F);
+		}
+
+		if (cp < 0x100) {
+			// Latin-1 Supplement: NBSP, punctuation and symbols are separators; the letters (and a few ordinals and fractions) are not.
+			if (cp == 0xAD)		// soft hyphen
+				return {WordJoiner, n};
+			if (cp == 0xAA || cp == 0xB2 || cp == 0xB3 || cp == 0xB5 || cp == 0xB9 || cp == 0xBA || (cp >= 0xBC && cp <= 0xBE))
+				return {WordCharacter, n};
+			if (cp <= 0xBF || cp == 0xD7 || cp == 0xF7)
+				return {WordSeparator, n};
+			return {WordCharacter, n};
+		}
+		if (cp >= 0x2000 && cp <= 0x206F) {
+			// General Punctuation: spaces, dashes, quotes, ... but ZWNJ/ZWJ, the 'real' hyphens and the typographic apostrophe glue words together.
+			if (cp == 0x200C || cp == 0x200D || cp == 0x2010 || cp == 0x2011 || cp == 0x2019)
+				return {WordJoiner, n};
+			return {WordSeparator, n};
+		}
+		if (cp >= 0x3000 && cp <= 0x303F)		// CJK Symbols and Punctuation, including the ideographic space
+			return {WordSeparator, n};
+		if ((cp >= 0x3040 && cp <= 0x30FF) || (cp >= 0x3400 && cp <= 0x9FFF) || (cp >= 0xF900 && cp <= 0xFAFF) || (cp >= 0x20000 && cp <= 0x3FFFF))
+			return {WordIdeograph, n};
+		if (cp == 0xFEFF)		// BOM / ZWNBSP
+			return {WordSeparator, n};
+		if ((cp >= 0xFF01 && cp <= 0xFF0F) || (cp >= 0xFF1A && cp <= 0xFF20) || (cp >= 0xFF3B && cp <= 0xFF40) || (cp >= 0xFF5B && cp <= 0xFF65))		// fullwidth punctuation
+			return {WordSeparator, n};
+		return {WordCharacter, n};
+	}
+
+	static inline std::pair<WordAction, size_t> classify_word_char(const WordActionTable &table, const uint8_t *p) {
+		WordAction a = table.actions[*p];
+		if (a == Utf8Lead) {
+			return classify_utf8(p);
+		}
+		return {a, 1};
+	}
+
+	// split [ptr, ptr+l) into words. `ptr[l]` MUST NOT be a word character, e.g. the NUL sentinel or an EOL.
+	template <class List>
+	static void split_words(const char *ptr, size_t l, const WordActionTable &table, List &words) {
+		const auto &actions = table.actions;
+		const auto* uptr = reinterpret_cast<const uint8_t *>(ptr);
+		size_t i = 0;
+		while (i < l) {
+			auto [a, n] = classify_word_char(table, uptr + i);
+			switch (a) {
+			case WordIdeograph:
+				words.emplace_back(ptr + i, n);
+				i += n;
 				continue;
+
+			case WordSeparator:
+			case WordJoiner:		// a joiner cannot start a word
+			default:
+				i += n;
+				continue;
+
+			[[likely]] case WordCharacter:
+				break;
 			}
+
+			const size_t start = i;
+			i += n;
+			for (;;) {
+				// the hot loop: plain ASCII word characters
+				while (actions[uptr[i]] == WordCharacter) {
+					i++;
+				}
+				auto [a2, n2] = classify_word_char(table, uptr + i);
+				if (a2 == WordCharacter) {
+					i += n2;
+					continue;
+				}
+				if (a2 == WordJoiner && i + n2 < l) {
+					// only accept the joiner when it is followed by another word character:
+					auto [a3, n3] = classify_word_char(table, uptr + i + n2);
+					if (a3 == WordCharacter) {
+						i += n2 + n3;
+						continue;
+					}
+				}
+				break;
+			}
+			words.emplace_back(ptr + start, std::min(i, l) - start);
 		}
 	}
 
 	void ExtendedFileContent::parseContentAsWords(const FileContentProcessingOptions& options, std::error_code &ec) {
 		ec.clear();
-		return;
+
+		// prep the actions table
+		const WordActionTable &actions = default_word_actions;
+
+		std::string_view d = file_content.content_view();
+		file_content.ensure_text_edge_sentinel();
+
+		const unsigned thread_count = split_thread_count_for(d.size(), options);
+		if (thread_count > 1) {
+			auto split_chunk = [&actions](std::string_view chunk, auto &part) {
+				part.reserve(chunk.size() / 6);
+				split_words(chunk.data(), chunk.size(), actions, part);
+			};
+			if (options.compact_spans) {
+				prepare_compact_list(compact_words, file_content);
+				split_in_parallel(d, thread_count, compact_words, split_chunk);
+			} else {
+				split_in_parallel(d, thread_count, words, split_chunk);
+			}
+			return;
+		}
+
+		// apply heuristic to estimate the number of words that will be found: ~ average word length plus separator in English text.
+		if (options.compact_spans) {
+			prepare_compact_list(compact_words, file_content);
+			compact_words.reserve(compact_words.size() + d.size() / 6);
+			split_words(d.data(), d.size(), actions, compact_words);
+		} else {
+			words.reserve(d.size() / 6);
+			split_words(d.data(), d.size(), actions, words);
+		}
 	}
 
+	// incremental splitting, e.g. while the content is still being loaded: see the pipelined `processFileEx()`.
+	void ExtendedFileContent::parseContentRangeAsWords(size_t start, size_t end, const FileContentProcessingOptions& options, std::error_code &ec) {
+		ec.clear();
+		assert(start <= end);
+
+		const WordActionTable &actions = default_word_actions;
+
+		const char *ptr = file_content.data() + start;
+		if (options.compact_spans) {
+			prepare_compact_list(compact_words, file_content);
+			split_words(ptr, end - start, actions, compact_words);
+		} else {
+			split_words(ptr, end - start, actions, words);
+		}
+	}
+
+	// sets up `content.ngram_dictionary` for n-grams of `options.ngram_size` words; returns nullptr on failure.
+	static NGramDictionary *prepare_ngram_dictionary(ExtendedFileContent &content, const FileContentProcessingOptions& options, std::error_code &ec) {
+		const unsigned n = std::max<unsigned>(options.ngram_size, 1);
+		if (n > NGramDictionary::max_ngram_size) {
+			// the dictionary would clamp it, after which a shared dictionary would fail on the next file: reject it right away.
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return nullptr;
+		}
+		if (!content.ngram_dictionary) {
+			content.ngram_dictionary = std::make_shared<NGramDictionary>(n);
+		} else if (content.ngram_dictionary->ngram_size() != n) {
+			// a shared dictionary can only carry n-grams of a single size.
+			ec = std::make_error_code(std::errc::invalid_argument);
+			return nullptr;
+		}
+		return content.ngram_dictionary.get();
+	}
+
+	// intern the next word and produce the n-gram it completes, if any.
+	static inline void push_ngram_word(NGramDictionary &dict, std::vector<NGramDictionary::word_id_t> &word_ids, ExtendedFileContent::ngram_list &ngrams, std::string_view word, std::error_code &ec) {
+		word_ids.push_back(dict.intern_word(word, ec));
+		if (ec)
+			return;
+		const unsigned n = dict.ngram_size();
+		if (word_ids.size() >= n) {
+			ngrams.push_back(dict.intern_ngram(word_ids.data() + word_ids.size() - n, ec));
+		}
+	}
+
+	// intern the n-grams of `words` into the dictionary: a list of either flavor.
+	template <class List>
+	static void intern_ngrams(NGramDictionary &dict, const List &words, ExtendedFileContent::ngram_list &ngrams, std::error_code &ec) {
+		const unsigned n = dict.ngram_size();
+		if (words.size() < n)
+			return;
+
+		const size_t count = words.size() - n + 1;
+		ngrams.reserve(count);
+		dict.reserve(dict.word_count() + words.size() / 4, dict.size() + count);
+
+		// intern all words first: then every n-gram is a plain run of word ids in this array.
+		std::vector<NGramDictionary::word_id_t> word_ids;
+		word_ids.reserve(words.size());
+		for (std::string_view w : words) {
+			if (push_ngram_word(dict, word_ids, ngrams, w, ec), ec)
+				return;
+		}
+	}
+
+	// slides a window of `options.ngram_size` words over `words` (or `compact_words`, when `options.compact_spans` is set)
+	// and interns each n-gram into `ngram_dictionary`.
+	//
+	// When the content has fewer words than a single n-gram needs, no n-grams are produced.
 	void ExtendedFileContent::parseContentAsNGrams(const FileContentProcessingOptions& options, std::error_code &ec) {
 		ec.clear();
-		return;
+
+		if (options.compact_spans ? compact_words.empty() : words.empty()) {
+			if (parseContentAsWords(options, ec), ec)
+				return;
+		}
+
+		NGramDictionary *dict = prepare_ngram_dictionary(*this, options, ec);
+		if (!dict)
+			return;
+
+		ngrams.clear();
+		if (options.compact_spans)
+			intern_ngrams(*dict, compact_words, ngrams, ec);
+		else
+			intern_ngrams(*dict, words, ngrams, ec);
 	}
 
-}
+	// parseContent():
+	//
+	// when more than one mode is requested, all of them are produced in a single traversal of the content: the content
+	// is walked line by line and each line is handed to the line emitter, the paragraph builder and the word splitter
+	// in turn, while it's still hot in the L1 cache; each new word is fed to the n-gram dictionary right away.
+	// Multi-GB inputs thus pass through the memory hierarchy once instead of once per mode.
+	//
+	// The output is identical to that of the separate `parseContentAs*()` calls.
+	template <class List>
+	static void parse_fused(ExtendedFileContent &content, const FileContentProcessingOptions& options, List &lines, List &words, std::error_code &ec) {
+		using mode = FileContentProcessingOptions::ParseMode;
+
+		const bool want_lines = (options.mode & mode::ToTextLines);
+		const bool want_paragraphs = (options.mode & mode::ToParagraphs);
+		const bool want_ngrams = (options.mode & mode::ToNGrams);
+		const bool want_words = (options.mode & mode::ToWords) || want_ngrams;
+
+		TextBuffer &file_content = content.file_content;
+		std::string_view d = file_content.content_view();
+		file_content.ensure_text_edge_sentinel();
+
+		const auto *ptr = d.data();
+		const size_t l = d.size();
+
+		// a single counting pre-pass serves both the lines and the paragraphs.
+		const SpanCountEstimate expected_counts = ((want_lines || want_paragraphs) ? estimate_span_counts(d, options) : SpanCountEstimate{0, 0});
+
+		ParagraphBuilder paragraph_builder(ptr, options, content.paragraphs);
+		if (want_paragraphs) {
+			if (paragraph_builder.begin(file_content, expected_counts.paragraphs, ec), ec)
+				return;
+		}
+
+		const WordActionTable &actions = default_word_actions;
+		if (want_words) {
+			words.reserve(words.size() + d.size() / 6);
+		}
+
+		NGramDictionary *dict = nullptr;
+		std::vector<NGramDictionary::word_id_t> word_ids;
+		if (want_ngrams) {
+			dict = prepare_ngram_dictionary(content, options, ec);
+			if (!dict)
+				return;
+			content.ngrams.clear();
+			const size_t estimated_word_count = words.size() + d.size() / 6;
+			word_ids.reserve(estimated_word_count);
+			content.ngrams.reserve(estimated_word_count);
+			// any words we already had come first, as with `parseContentAsNGrams()`.
+			for (std::string_view w : words) {
+				if (push_ngram_word(*dict, word_ids, content.ngrams, w, ec), ec)
+					return;
+			}
+		}
+
+		if (want_lines) {
+			lines.reserve(lines.size() + expected_counts.lines);
+		}
+
+		size_t i = 0;
+		while (i < l) {
+			const size_t ls = i;
+			const size_t le = next_line(ptr, l, i);
 
+			if (want_lines) {
+				emit_line(ptr, ls, le, options.trim_outer_whitespace, options.accept_comment_lines, lines);
+			}
+			if (want_paragraphs) {
+				paragraph_builder.add_line(ls, le, ptr[le] == '\f');
+			}
+			if (want_words) {
+				// words never span a line end, and ptr[le] is an EOL character, i.e. a word separator: that's all `split_words()` needs.
+				const size_t first = words.size();
+				split_words(ptr + ls, le - ls, actions, words);
+				if (want_ngrams) {
+					for (size_t w = first; w < words.size(); w++) {
+						if (push_ngram_word(*dict, word_ids, content.ngrams, words[w], ec), ec)
+							return;
+					}
+				}
+			}
+		}
+
+		if (want_paragraphs) {
+			paragraph_builder.finish(file_content);
+		}
+	}
+
+	void ExtendedFileContent::parseContent(const FileContentProcessingOptions& options, std::error_code &ec) {
+		ec.clear();
+
+		using mode = FileContentProcessingOptions::ParseMode;
+
+		if (std::popcount(unsigned(options.mode & (mode::ToTextLines | mode::ToParagraphs | mode::ToWords | mode::ToNGrams))) <= 1) {
+			if (options.mode & mode::ToTextLines)
+				parseContentAsLines(options, ec);
+			else if (options.mode & mode::ToParagraphs)
+				parseContentAsParagraphs(options, ec);
+			else if (options.mode & mode::ToNGrams)
+				parseContentAsNGrams(options, ec);
+			else if (options.mode & mode::ToWords)
+				parseContentAsWords(options, ec);
+			return;
+		}
+
+		if (options.compact_spans) {
+			prepare_compact_list(compact_lines, file_content);
+			prepare_compact_list(compact_words, file_content);
+			parse_fused(*this, options, compact_lines, compact_words, ec);
+		} else {
+			parse_fused(*this, options, lines, words, ec);
+		}
+	}
+
+}
@@ -0,0 +1,173 @@
+//
+// Load an entire corpus, i.e. all files listed in a response file, using a pool of worker threads.
+//
+
+#include "CorpusLoader.hpp"
+
+#include "PrivateUtilities.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+
+namespace text_processing {
+
+	namespace fs = std::filesystem;
+
+	namespace {
+
+		struct LoadedFile {
+			// the amount charged against the in-flight budget for this one.
+			size_t charged_bytes;
+			ExtendedFileContentParseResult result;
+		};
+
+		// the state shared by the workers and the delivering (calling) thread.
+		//
+		// Work distribution: the workers grab the next file index off a shared atomic ticket counter. For a corpus of
+		// (many) files of (wildly) varying sizes this balances the load just as well as per-thread queues with work
+		// stealing would, as any idle worker immediately takes the next file, without any of the queue management.
+		struct CorpusLoaderState {
+			const ResponseFilesSet &corpus;
+			const FileContentProcessingOptions &options;
+			const CorpusLoadingOptions &corpus_options;
+			const searchPaths &search_paths;
+
+			std::atomic<size_t> next_ticket{0};
+			std::atomic<bool> cancelled{false};
+
+			std::mutex mtx;
+			std::condition_variable budget_cv;			// workers wait here for in-flight budget
+			std::condition_variable delivery_cv;		// the delivering thread waits here for results
+
+			// --- protected by mtx: ---
+			size_t in_flight_bytes = 0;
+			size_t next_delivery = 0;					// the lowest index not yet delivered (in-order delivery mode)
+			std::map<size_t, LoadedFile> ready;
+
+			CorpusLoaderState(const ResponseFilesSet &corpus, const FileContentProcessingOptions &options, const CorpusLoadingOptions &corpus_options, const searchPaths &search_paths) :
+				corpus(corpus), options(options), corpus_options(corpus_options), search_paths(search_paths) {
+			}
+
+			void worker(void);
+		};
+
+		void CorpusLoaderState::worker(void) {
+			const size_t count = corpus.files.size();
+			for (;;) {
+				const size_t i = next_ticket.fetch_add(1, std::memory_order_relaxed);
+				if (i >= count || cancelled.load(std::memory_order_relaxed))
+					break;
+
+				const path &filepath = corpus.files[i];
+
+				// charge the buffer space `processFileEx()` is going to allocate up front; when we cannot determine the
+				// file size, `processFileEx()` will report the error anyway.
+				std::error_code ec;
+				std::uintmax_t filesize = fs::file_size(filepath, ec);
+				size_t charge = (ec ? 0 : estimateRequiredLumpSumBufferSpace(filesize, options));
+
+				{
+					std::unique_lock lk(mtx);
+					// the file next in line for in-order delivery is always admitted: otherwise the budget may be
+					// fully taken by files which wait for it to be delivered first --> deadlock.
+					budget_cv.wait(lk, [&] {
+						return cancelled.load(std::memory_order_relaxed)
+							|| in_flight_bytes == 0
+							|| in_flight_bytes + charge <= corpus_options.max_in_flight_bytes
+							|| (corpus_options.deliver_in_order && i == next_delivery);
+					});
+					if (cancelled.load(std::memory_order_relaxed))
+						break;
+					in_flight_bytes += charge;
+				}
+
+				auto r = processFileEx(filepath, search_paths, options);
+
+				{
+					std::lock_guard lk(mtx);
+					// now we know the actual buffer space taken: re-charge accordingly.
+					size_t actual = (r.has_value() ? r.value().file_content.capacity() : 0);
+					in_flight_bytes = in_flight_bytes - charge + actual;
+					ready.emplace(i, LoadedFile{actual, std::move(r)});
+				}
+				delivery_cv.notify_one();
+			}
+		}
+
+	}
+
+	std::expected<size_t, ErrorResponse> loadCorpus(const ResponseFilesSet &corpus, const CorpusFileCallback &callback, const FileContentProcessingOptions &options, const CorpusLoadingOptions &corpus_options, const searchPaths& search_paths) {
+		const size_t count = corpus.files.size();
+		if (count == 0)
+			return 0;
+
+		// the arena is not thread-safe, and arena memory only comes back on `reset()`, which would defeat the in-flight
+		// budget anyway: the workers load into heap buffers instead.
+		FileContentProcessingOptions worker_options = options;
+		worker_options.arena = nullptr;
+
+		CorpusLoaderState state(corpus, worker_options, corpus_options, search_paths);
+
+		unsigned thread_count = corpus_options.thread_count;
+		if (thread_count == 0)
+			thread_count = std::max(1U, std::thread::hardware_concurrency());
+		thread_count = unsigned(std::min<size_t>(thread_count, count));
+
+		std::vector<std::jthread> workers;
+		workers.reserve(thread_count);
+		try {
+			for (unsigned t = 0; t < thread_count; t++) {
+				workers.emplace_back([&state] {
+					state.worker();
+				});
+			}
+		} catch (const std::system_error &e) {
+			if (workers.empty()) {
+				return std::unexpected{ErrorResponse{std::errc::resource_unavailable_try_again, std::format("cannot start the corpus loader worker threads: {}", e.what())}};
+			}
+			// else: make do with the threads we've got.
+		}
+
+		if (false) std::cout << "loading corpus of " << count << " files using " << workers.size() << " threads.\n";
+
+		size_t delivered = 0;
+		std::unique_lock lk(state.mtx);
+		while (delivered < count) {
+			state.delivery_cv.wait(lk, [&] {
+				return !state.ready.empty() && (!corpus_options.deliver_in_order || state.ready.begin()->first == state.next_delivery);
+			});
+			auto node = state.ready.extract(state.ready.begin());
+			lk.unlock();
+
+			const size_t index = node.key();
+			bool go_on = callback(index, corpus.files[index], std::move(node.mapped().result));
+			delivered++;
+			const size_t released = node.mapped().charged_bytes;
+			// release the file content (unless the callback took it) before we hand the budget back.
+			node = {};
+
+			lk.lock();
+			state.in_flight_bytes -= released;
+			if (corpus_options.deliver_in_order)
+				state.next_delivery = index + 1;
+			state.budget_cv.notify_all();
+
+			if (!go_on) {
+				state.cancelled = true;
+				break;
+			}
+		}
+		lk.unlock();
+		state.budget_cv.notify_all();
+
+		// the jthreads join on destruction.
+		workers.clear();
+
+		return delivered;
+	}
+
+}
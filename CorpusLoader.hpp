@@ -0,0 +1,50 @@
+//
+// Load an entire corpus, i.e. all files listed in a response file, using a pool of worker threads.
+//
+// Each file is loaded and split by `processFileEx()` on one of the workers; the results are handed to the
+// caller's callback on the *calling* thread, either in response file order or as soon as they're available.
+//
+// The amount of loaded-but-not-yet-delivered file content is bounded, so a slow consumer (or a corpus of
+// huge files) won't make us run out of memory.
+//
+
+#pragma once
+
+#include "Base.hpp"
+#include "ReadFileContents.hpp"
+#include "ResponseFileHandling.hpp"
+
+#include <functional>
+
+
+namespace text_processing {
+
+	using std::filesystem::path;
+
+	struct CorpusLoadingOptions {
+		// number of worker threads; 0: one per hardware thread.
+		unsigned thread_count = 0;
+
+		// upper bound for the buffer space (in bytes) held by loaded files which have not been delivered yet.
+		//
+		// A single file larger than this is still loaded: it just has to wait until it has the budget all to itself.
+		size_t max_in_flight_bytes = 256 * 1024 * 1024;
+
+		// deliver the files in the order in which they are listed in the response file, rather than as-completed.
+		bool deliver_in_order{true};
+	};
+
+	// `index` is the index of `filepath` in `ResponseFilesSet::files`; `result` is what `processFileEx()` produced for it.
+	//
+	// Return `false` to abort loading the corpus.
+	using CorpusFileCallback = std::function<bool(size_t index, const path &filepath, ExtendedFileContentParseResult &&result)>;
+
+	// Returns the number of files delivered to the callback.
+	//
+	// Errors loading individual files are delivered to the callback, like any other result; the corpus loader
+	// itself only fails when it cannot start any worker thread.
+	//
+	// NOTE: `options.arena` is ignored: the files are loaded concurrently, into heap buffers of their own.
+	std::expected<size_t, ErrorResponse> loadCorpus(const ResponseFilesSet &corpus, const CorpusFileCallback &callback, const FileContentProcessingOptions &options = {}, const CorpusLoadingOptions &corpus_options = {}, const searchPaths& search_paths = {});
+
+}
@@ -0,0 +1,544 @@
+//
+// Batched file loading: io_uring on Linux, with a plain open/fstat/pread/close fallback.
+//
+
+#include "FileBatchReader.hpp"
+#include "FileLookupCache.hpp"
+
+#include "PrivateUtilities.hpp"
+
+#include <cstring>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define TEXT_PROCESSING_HAS_IO_URING  1
+#endif
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#if defined(TEXT_PROCESSING_HAS_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <atomic>
+#endif
+
+
+namespace text_processing {
+
+	namespace {
+
+		ErrorResponse open_error(const path &p, int e) {
+			return ErrorResponse{std::errc::io_error, std::format("cannot open file \"{}\": error {}:{}", p.generic_string(), e, strerror(e))};
+		}
+
+		ErrorResponse read_error(const path &p, int e) {
+			return ErrorResponse{std::errc::io_error, std::format("cannot read file content of file \"{}\": error {}:{}", p.generic_string(), e, strerror(e))};
+		}
+
+		ErrorResponse buffer_error(const path &p) {
+			return ErrorResponse{std::errc::not_enough_memory, std::format("out of memory while processing file \"{}\".", p.generic_string())};
+		}
+
+		bool reserve_buffer(TextBuffer &buffer, size_t filesize, const FileBatchLoadingOptions& batch_options) {
+			std::error_code ec;
+			if (batch_options.arena) {
+				buffer.reserve(filesize + TextBuffer::sentinel_size, *batch_options.arena, ec);
+			} else {
+				buffer.reserve(filesize + TextBuffer::sentinel_size, ec);
+			}
+			return !ec;
+		}
+
+		// as `FileReader::readRemainingContentUntilEOF()` does: read into all of the buffer but the sentinel; once that's
+		// filled, peek into the sentinel space to see whether we're at EOF.
+		size_t next_read_amount(const TextBuffer &buffer, size_t done) {
+			const size_t room = buffer.capacity() - TextBuffer::sentinel_size;
+			return (done < room ? room - done : TextBuffer::sentinel_size);
+		}
+
+		// the file has grown since we sized the buffer for it? Then make room for more.
+		bool grow_buffer_as_needed(TextBuffer &buffer, size_t done) {
+			if (done <= buffer.capacity() - TextBuffer::sentinel_size)
+				return true;
+			std::error_code ec;
+			buffer.grow(done + std::max<size_t>(done / 2, 64 * 1024), ec);
+			return !ec;
+		}
+
+		// as `FileReader::readAllContent()` does.
+		void finish_buffer(TextBuffer &buffer, size_t length) {
+			buffer.data()[length] = 0;
+			buffer.set_content_size(length);
+		}
+
+		FileContentParseResult load_file_the_plain_way(const path &p, const FileBatchLoadingOptions& batch_options) {
+#if defined(_WIN32)
+			return processFile(p);
+#else
+			const int fd = ::open(p.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0) {
+				return std::unexpected{open_error(p, errno)};
+			}
+			struct stat st;
+			if (fstat(fd, &st) != 0) {
+				auto e = errno;
+				::close(fd);
+				return std::unexpected{read_error(p, e)};
+			}
+			const size_t filesize = size_t(st.st_size);
+			TextBuffer buffer;
+			if (!reserve_buffer(buffer, filesize, batch_options)) {
+				::close(fd);
+				return std::unexpected{buffer_error(p)};
+			}
+			// read until EOF, like `processFile()` does: the file MAY have changed since we took its size.
+			size_t done = 0;
+			for (;;) {
+				const ssize_t n = pread(fd, buffer.data() + done, next_read_amount(buffer, done), off_t(done));
+				if (n < 0) {
+					if (errno == EINTR)
+						continue;
+					auto e = errno;
+					::close(fd);
+					return std::unexpected{read_error(p, e)};
+				}
+				if (n == 0)
+					break;
+				done += size_t(n);
+				if (!grow_buffer_as_needed(buffer, done)) {
+					::close(fd);
+					return std::unexpected{buffer_error(p)};
+				}
+			}
+			::close(fd);
+			finish_buffer(buffer, done);
+			return FileContent(std::move(buffer));
+#endif
+		}
+
+#if defined(TEXT_PROCESSING_HAS_IO_URING)
+
+		// a bare bones io_uring: liburing is not a dependency of ours, so we talk to the kernel directly.
+		// Single threaded use only: we're the sole producer of SQEs and the sole consumer of CQEs.
+		class IoUring {
+		public:
+			IoUring() = default;
+			IoUring(const IoUring &) = delete;
+			IoUring &operator=(const IoUring &) = delete;
+
+			~IoUring() {
+				if (_sqes != MAP_FAILED)
+					munmap(_sqes, _sqes_size);
+				if (_cq_ring != MAP_FAILED && _cq_ring != _sq_ring)
+					munmap(_cq_ring, _cq_ring_size);
+				if (_sq_ring != MAP_FAILED)
+					munmap(_sq_ring, _sq_ring_size);
+				if (_fd >= 0)
+					::close(_fd);
+			}
+
+			bool setup(unsigned entries) {
+				io_uring_params params{};
+				_fd = int(syscall(__NR_io_uring_setup, entries, &params));
+				if (_fd < 0)
+					return false;
+
+				_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+				_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+				const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP);
+				if (single_mmap) {
+					_sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+				}
+
+				_sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+				if (_sq_ring == MAP_FAILED)
+					return false;
+				if (single_mmap) {
+					_cq_ring = _sq_ring;
+				} else {
+					_cq_ring = mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+					if (_cq_ring == MAP_FAILED)
+						return false;
+				}
+				_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+				_sqes = static_cast<io_uring_sqe *>(mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES));
+				if (_sqes == MAP_FAILED)
+					return false;
+
+				char *sq = static_cast<char *>(_sq_ring);
+				_sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+				_sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+				_sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+				_sq_entries = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+				_sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+				_sq_local_tail = *_sq_tail;
+
+				char *cq = static_cast<char *>(_cq_ring);
+				_cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+				_cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+				_cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+				_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+				return true;
+			}
+
+			// returns a zeroed SQE, or nullptr when the submission queue is full.
+			io_uring_sqe *get_sqe() {
+				const unsigned head = std::atomic_ref<unsigned>(*_sq_head).load(std::memory_order_acquire);
+				if (_sq_local_tail - head >= _sq_entries)
+					return nullptr;
+				const unsigned idx = _sq_local_tail & _sq_mask;
+				io_uring_sqe *sqe = &_sqes[idx];
+				memset(sqe, 0, sizeof(*sqe));
+				_sq_array[idx] = idx;
+				_sq_local_tail++;
+				return sqe;
+			}
+
+			// submit all SQEs handed out so far and wait for (at least) `wait_nr` completions. Returns -errno on failure.
+			int submit_and_wait(unsigned wait_nr) {
+				std::atomic_ref<unsigned>(*_sq_tail).store(_sq_local_tail, std::memory_order_release);
+				// everything the kernel hasn't consumed yet, including the SQEs a previous (failed or partial)
+				// submission left behind.
+				const unsigned to_submit = _sq_local_tail - std::atomic_ref<unsigned>(*_sq_head).load(std::memory_order_acquire);
+				int rv;
+				do {
+					rv = int(syscall(__NR_io_uring_enter, _fd, to_submit, wait_nr, (wait_nr ? IORING_ENTER_GETEVENTS : 0), nullptr, 0));
+				} while (rv < 0 && errno == EINTR);
+				return (rv < 0 ? -errno : rv);
+			}
+
+			bool pop_cqe(io_uring_cqe &cqe) {
+				const unsigned head = *_cq_head;
+				if (head == std::atomic_ref<unsigned>(*_cq_tail).load(std::memory_order_acquire))
+					return false;
+				cqe = _cqes[head & _cq_mask];
+				std::atomic_ref<unsigned>(*_cq_head).store(head + 1, std::memory_order_release);
+				return true;
+			}
+
+		protected:
+			int _fd = -1;
+
+			void *_sq_ring = MAP_FAILED;
+			size_t _sq_ring_size = 0;
+			void *_cq_ring = MAP_FAILED;
+			size_t _cq_ring_size = 0;
+			io_uring_sqe *_sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+			size_t _sqes_size = 0;
+
+			unsigned *_sq_head = nullptr;
+			unsigned *_sq_tail = nullptr;
+			unsigned *_sq_array = nullptr;
+			unsigned _sq_mask = 0;
+			unsigned _sq_entries = 0;
+			unsigned _sq_local_tail = 0;		// includes the SQEs handed out but not yet submitted
+
+			unsigned *_cq_head = nullptr;
+			unsigned *_cq_tail = nullptr;
+			unsigned _cq_mask = 0;
+			io_uring_cqe *_cqes = nullptr;
+		};
+
+		// the state of one file in flight. Each file goes through:
+		//
+		//   openat --> statx (of the opened file) --> read (repeated until EOF) --> close
+		//
+		// so a slot never has more than one operation in flight.
+		struct BatchSlot {
+			enum Op : uint8_t {
+				OpOpen = 0,
+				OpStatx,
+				OpRead,
+				OpClose,
+			};
+
+			enum Stage : uint8_t {
+				Idle = 0,
+				Opening,
+				Stating,
+				Reading,
+				Closing,
+			} stage = Idle;
+
+			size_t index = 0;						// into the file list
+			std::string native_path;				// must live until the openat completes
+			struct statx stx;
+			int fd = -1;
+			int error = 0;							// errno of the first failure
+			Op failed_op = OpOpen;
+			unsigned pending = 0;					// operations in flight
+			size_t done = 0;
+			bool eof = false;
+			TextBuffer buffer;
+		};
+
+		class BatchLoader {
+		public:
+			BatchLoader(const std::vector<size_t> &todo, const std::vector<path> &resolved, std::vector<FileContentParseResult> &results, const FileBatchLoadingOptions& batch_options) :
+				todo(todo), resolved(resolved), results(results), batch_options(batch_options) {
+			}
+
+			bool run(void);
+
+		protected:
+			const std::vector<size_t> &todo;
+			const std::vector<path> &resolved;
+			std::vector<FileContentParseResult> &results;
+			const FileBatchLoadingOptions& batch_options;
+
+			IoUring ring;
+			std::vector<BatchSlot> slots;
+
+			io_uring_sqe *next_sqe(unsigned slot, BatchSlot::Op op, uint8_t opcode, int fd, const void *addr, unsigned len, uint64_t off);
+			void start(unsigned slot, size_t index);
+			void submit_read(unsigned slot);
+			void submit_close(unsigned slot);
+			void finish(unsigned slot);
+			void complete(unsigned slot, BatchSlot::Op op, int res);
+		};
+
+		io_uring_sqe *BatchLoader::next_sqe(unsigned slot, BatchSlot::Op op, uint8_t opcode, int fd, const void *addr, unsigned len, uint64_t off) {
+			io_uring_sqe *sqe = ring.get_sqe();
+			while (!sqe) {
+				// cannot happen with the ring sized for twice the operations in flight, but better safe than sorry.
+				ring.submit_and_wait(0);
+				sqe = ring.get_sqe();
+			}
+			sqe->opcode = opcode;
+			sqe->fd = fd;
+			sqe->addr = reinterpret_cast<uint64_t>(addr);
+			sqe->len = len;
+			sqe->off = off;
+			sqe->user_data = (uint64_t(slot) << 2) | op;
+			slots[slot].pending++;
+			return sqe;
+		}
+
+		void BatchLoader::start(unsigned slot, size_t index) {
+			BatchSlot &s = slots[slot];
+			s.stage = BatchSlot::Opening;
+			s.index = index;
+			s.native_path = resolved[index].native();
+			s.fd = -1;
+			s.error = 0;
+			s.pending = 0;
+			s.done = 0;
+			s.eof = false;
+			s.buffer = TextBuffer();
+
+			io_uring_sqe *sqe = next_sqe(slot, BatchSlot::OpOpen, IORING_OP_OPENAT, AT_FDCWD, s.native_path.c_str(), 0, 0);
+			sqe->open_flags = O_RDONLY | O_CLOEXEC;
+		}
+
+		void BatchLoader::submit_read(unsigned slot) {
+			BatchSlot &s = slots[slot];
+			// a single read is limited to ~2 GB anyway; big files simply take a few rounds.
+			const unsigned amount = unsigned(std::min<size_t>(next_read_amount(s.buffer, s.done), 1U << 30));
+			next_sqe(slot, BatchSlot::OpRead, IORING_OP_READ, s.fd, s.buffer.data() + s.done, amount, s.done);
+		}
+
+		void BatchLoader::submit_close(unsigned slot) {
+			BatchSlot &s = slots[slot];
+			s.stage = BatchSlot::Closing;
+			if (s.fd >= 0) {
+				next_sqe(slot, BatchSlot::OpClose, IORING_OP_CLOSE, s.fd, nullptr, 0, 0);
+				s.fd = -1;
+			}
+		}
+
+		// deliver the result for the file in `slot` and close it.
+		void BatchLoader::finish(unsigned slot) {
+			BatchSlot &s = slots[slot];
+			if (s.error == EINVAL || s.error == EOPNOTSUPP) {
+				// this kernel doesn't do this operation through io_uring: take the classic route for this one.
+				results[s.index] = load_file_the_plain_way(resolved[s.index], batch_options);
+			} else if (s.error) {
+				const path &p = resolved[s.index];
+				results[s.index] = std::unexpected{s.failed_op == BatchSlot::OpOpen ? open_error(p, s.error) : read_error(p, s.error)};
+			} else {
+				finish_buffer(s.buffer, s.done);
+				results[s.index] = FileContent(std::move(s.buffer));
+			}
+			submit_close(slot);
+		}
+
+		void BatchLoader::complete(unsigned slot, BatchSlot::Op op, int res) {
+			BatchSlot &s = slots[slot];
+			s.pending--;
+
+			switch (op) {
+			case BatchSlot::OpOpen:
+				if (res >= 0)
+					s.fd = res;
+				break;
+
+			case BatchSlot::OpRead:
+				if (res == -EINTR || res == -EAGAIN) {
+					submit_read(slot);
+					return;
+				}
+				if (res == 0) {
+					s.eof = true;
+				} else if (res > 0) {
+					s.done += size_t(res);
+				}
+				break;
+
+			case BatchSlot::OpStatx:
+			case BatchSlot::OpClose:
+			default:
+				break;
+			}
+			if (res < 0 && op != BatchSlot::OpClose && !s.error) {
+				s.error = -res;
+				s.failed_op = op;
+			}
+
+			if (s.pending > 0)
+				return;
+
+			switch (s.stage) {
+			case BatchSlot::Opening:
+				if (!s.error) {
+					// stat the file we've actually opened: the path MAY point elsewhere by now.
+					s.stage = BatchSlot::Stating;
+					io_uring_sqe *sqe = next_sqe(slot, BatchSlot::OpStatx, IORING_OP_STATX, s.fd, "", STATX_SIZE, reinterpret_cast<uint64_t>(&s.stx));
+					sqe->statx_flags = AT_EMPTY_PATH;
+					break;
+				}
+				finish(slot);
+				break;
+
+			case BatchSlot::Stating:
+				if (!s.error) {
+					if (!reserve_buffer(s.buffer, size_t(s.stx.stx_size), batch_options)) {
+						results[s.index] = std::unexpected{buffer_error(resolved[s.index])};
+						submit_close(slot);
+						break;
+					}
+					s.stage = BatchSlot::Reading;
+					submit_read(slot);
+					break;
+				}
+				finish(slot);
+				break;
+
+			case BatchSlot::Reading:
+				// read until EOF, like `processFile()` does: the file MAY have changed since we took its size.
+				if (!s.error && !s.eof) {
+					if (!grow_buffer_as_needed(s.buffer, s.done)) {
+						results[s.index] = std::unexpected{buffer_error(resolved[s.index])};
+						submit_close(slot);
+						break;
+					}
+					submit_read(slot);
+					break;
+				}
+				finish(slot);
+				break;
+
+			case BatchSlot::Closing:
+			case BatchSlot::Idle:
+			default:
+				break;
+			}
+
+			if (s.stage == BatchSlot::Closing && s.pending == 0) {
+				s.stage = BatchSlot::Idle;
+			}
+		}
+
+		bool BatchLoader::run(void) {
+			const unsigned depth = std::clamp(batch_options.queue_depth, 1U, 4096U);
+			// one operation per slot at most: plenty room to spare in the submission queue; the completion queue is twice its size by default.
+			if (!ring.setup(2 * depth))
+				return false;
+
+			slots.resize(depth);
+			std::vector<unsigned> idle;
+			idle.reserve(depth);
+			for (unsigned i = depth; i > 0; i--) {
+				idle.push_back(i - 1);
+			}
+
+			size_t next = 0;
+			while (next < todo.size() || idle.size() < depth) {
+				while (next < todo.size() && !idle.empty()) {
+					const unsigned slot = idle.back();
+					idle.pop_back();
+					start(slot, todo[next++]);
+				}
+
+				if (int rv = ring.submit_and_wait(1); rv < 0 && rv != -EBUSY && rv != -EAGAIN) {
+					// the ring itself failed: finish the remainder the classic way.
+					if (false) std::cout << "io_uring_enter failed: " << strerror(-rv) << '\n';
+					for (auto &s : slots) {
+						if (s.stage == BatchSlot::Opening || s.stage == BatchSlot::Stating || s.stage == BatchSlot::Reading) {
+							results[s.index] = load_file_the_plain_way(resolved[s.index], batch_options);
+						}
+					}
+					for (; next < todo.size(); next++) {
+						results[todo[next]] = load_file_the_plain_way(resolved[todo[next]], batch_options);
+					}
+					// the operations in flight may still complete after we're gone and write into the slots' buffers
+					// and statx records, hence we leak those on purpose. This is an emergency exit after all.
+					(void)new std::vector<BatchSlot>(std::move(slots));
+					return true;
+				}
+				// EBUSY/EAGAIN: the completion queue is full (or the kernel is short of resources): reap and retry.
+
+				io_uring_cqe cqe;
+				while (ring.pop_cqe(cqe)) {
+					const unsigned slot = unsigned(cqe.user_data >> 2);
+					complete(slot, BatchSlot::Op(cqe.user_data & 3), cqe.res);
+					if (slots[slot].stage == BatchSlot::Idle) {
+						idle.push_back(slot);
+					}
+				}
+			}
+			return true;
+		}
+
+#endif
+
+	}
+
+	std::vector<FileContentParseResult> processFileBatch(const std::vector<path>& filepaths, const searchPaths& search_paths, const FileBatchLoadingOptions& batch_options) {
+		std::vector<FileContentParseResult> results(filepaths.size());
+
+		// resolve the paths first; many files in a few directories is where the lookup cache shines.
+		FileLookupCache lookup_cache;
+		std::vector<path> resolved(filepaths.size());
+		std::vector<size_t> todo;
+		todo.reserve(filepaths.size());
+		for (size_t i = 0; i < filepaths.size(); i++) {
+			auto p = locateFile(filepaths[i], filepaths[i], search_paths, true, true, true, &lookup_cache);
+			if (!p.has_value()) {
+				results[i] = std::unexpected{p.error()};
+				continue;
+			}
+			resolved[i] = std::move(p.value());
+			todo.push_back(i);
+		}
+
+#if defined(TEXT_PROCESSING_HAS_IO_URING)
+		if (batch_options.use_io_uring && !todo.empty()) {
+			BatchLoader loader(todo, resolved, results, batch_options);
+			if (loader.run())
+				return results;
+			// else: no io_uring for us (old kernel, seccomp, ...): take the classic route.
+		}
+#endif
+
+		for (size_t i : todo) {
+			results[i] = load_file_the_plain_way(resolved[i], batch_options);
+		}
+		return results;
+	}
+
+}
@@ -0,0 +1,37 @@
+//
+// Load many (small) files at once: batched I/O for corpora of millions of files.
+//
+
+#pragma once
+
+#include "ReadFileContents.hpp"
+
+
+namespace text_processing {
+
+	struct FileBatchLoadingOptions {
+		// the number of files in flight at any time.
+		unsigned queue_depth = 64;
+
+		// Linux: submit the open/stat/read/close calls for all files in flight through a single io_uring instead of
+		// issuing them one blocking syscall at a time. When io_uring is not available (older kernels, seccomp
+		// policies, other platforms) or this is false, the files are loaded one by one using plain open/fstat/pread/close.
+		bool use_io_uring = true;
+
+		// optional: allocate the file content buffers from this arena instead of the heap.
+		TextBufferArena *arena = nullptr;
+	};
+
+	// the batch flavor of `processFile()`: load all files, results in the order of `filepaths`.
+	//
+	// The file paths are resolved as `processFile()` does, through a shared `FileLookupCache`. Each result carries the
+	// file content in a `TextBuffer` of its own (or an error), plus sentinel, exactly as `processFile()` would produce
+	// it with `ReadIntoBuffer`: the files are read until EOF, so a file which changes size while we're loading it (or
+	// which reports no size at all, as /proc files do) is loaded in full all the same.
+	//
+	// For a corpus of many 2-20 KB files the cost is in the syscalls, not in the copying: 4+ blocking syscalls per
+	// file, plus the stat for the file size. The io_uring backend keeps `queue_depth` files in flight and handles the
+	// whole lot with about one `io_uring_enter()` per round.
+	std::vector<FileContentParseResult> processFileBatch(const std::vector<path>& filepaths, const searchPaths& search_paths = {}, const FileBatchLoadingOptions& batch_options = {});
+
+}
@@ -0,0 +1,111 @@
+
+#include "FileLookupCache.hpp"
+
+namespace text_processing {
+
+	namespace fs = std::filesystem;
+
+	FileLookupCache::FileLookupCache() :
+		_cwd(fs::current_path()) {
+	}
+
+	void FileLookupCache::invalidate() {
+		_cwd = fs::current_path();
+		_directories.clear();
+		_slow_results.clear();
+	}
+
+	void FileLookupCache::invalidate(const path &directory) {
+		path normalized = NormalizePathToUnixSeparators(directory);
+		std::erase_if(_directories, [&](const auto &item) {
+			return item.second.normalized == normalized;
+		});
+		// we cannot tell which of these went through this directory: drop them all.
+		_slow_results.clear();
+	}
+
+	FileLookupCache::DirectoryInfo &FileLookupCache::directory(const path &dir) {
+		auto [it, inserted] = _directories.try_emplace(dir.generic_string());
+		DirectoryInfo &info = it->second;
+		if (inserted) {
+			std::error_code ec;
+			info.normalized = NormalizePathToUnixSeparators(dir);
+			info.is_directory = fs::is_directory(info.normalized, ec);
+		}
+		return info;
+	}
+
+	// what `locateFile()` does for each candidate path.
+	std::optional<path> FileLookupCache::probe_the_slow_way(const path &candidate) {
+		auto [it, inserted] = _slow_results.try_emplace(candidate.generic_string());
+		if (inserted) {
+			path f = NormalizePathToUnixSeparators(candidate);
+			if (fs::exists(f)) {
+				it->second = std::move(f);
+			}
+		}
+		if (it->second.empty())
+			return std::nullopt;
+		return it->second;
+	}
+
+	std::optional<path> FileLookupCache::probe(const path &candidate) {
+		path name = candidate.filename();
+		if (name.empty() || name == "." || name == "..") {
+			return probe_the_slow_way(candidate);
+		}
+
+		DirectoryInfo &dir = directory(candidate.parent_path());
+		if (!dir.is_directory) {
+			// the normalized candidate path can only exist when its normalized parent directory does.
+			return std::nullopt;
+		}
+
+		std::error_code ec;
+		if (!dir.listed && ++dir.probe_count >= listing_threshold) {
+			dir.entries.clear();
+			for (const auto &entry : fs::directory_iterator(dir.normalized, ec)) {
+				dir.entries.emplace(entry.path().filename().string(), entry.is_symlink(ec) ? EntryKind::Symlink : EntryKind::Plain);
+			}
+			dir.listed = !ec;
+			if (!dir.listed)
+				dir.entries.clear();
+		}
+
+		const std::string key = name.string();
+		auto it = dir.entries.find(key);
+		if (it == dir.entries.end()) {
+			if (dir.listed) {
+				if (!case_sensitive_names)
+					return probe_the_slow_way(candidate);
+				return std::nullopt;
+			}
+			if (!case_sensitive_names) {
+				// `lstat()` would match another case, while the normalized path carries the on-disk case.
+				return probe_the_slow_way(candidate);
+			}
+			fs::file_status st = fs::symlink_status(dir.normalized / name, ec);
+			EntryKind kind = (fs::is_symlink(st) ? EntryKind::Symlink : fs::exists(st) ? EntryKind::Plain : EntryKind::Missing);
+			it = dir.entries.emplace(key, kind).first;
+		}
+
+		switch (it->second) {
+		case EntryKind::Missing:
+			return std::nullopt;
+
+		case EntryKind::Symlink:
+			// the normalized path is the link target.
+			return probe_the_slow_way(candidate);
+
+		case EntryKind::Plain:
+		default:
+			break;
+		}
+#if defined(_WIN32)
+		return path((dir.normalized / name).generic_string());
+#else
+		return dir.normalized / name;
+#endif
+	}
+
+}
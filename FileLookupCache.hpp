@@ -0,0 +1,92 @@
+//
+// A lookup cache for `locateFile()` & friends: remembers which files do (and do not) exist in the directories probed before.
+//
+
+#pragma once
+
+#include "Base.hpp"
+
+#include <optional>
+#include <unordered_map>
+
+
+namespace text_processing {
+
+	using std::filesystem::path;
+
+	// Hand this one to `locateFile()` (or `processAsResponseFile()`, via `ResponsefileProcessingOptions::lookup_cache`)
+	// and repeated lookups against the same directories become in-memory hash probes:
+	//
+	// - the current working directory is fetched once;
+	// - each (raw) directory is normalized (`weakly_canonical()`) only once; a candidate path then is that directory plus
+	//   the file name;
+	// - once a directory has been probed `listing_threshold` times, it is scanned once and all further lookups in that
+	//   directory are served from the listing. Before that, each probe costs a single `lstat()` and its outcome, positive
+	//   or negative, is remembered.
+	//
+	// The results are identical to those of an uncached `locateFile()`: symlinks (which `weakly_canonical()` resolves) and
+	// '.'/'..' names take the slow path through `NormalizePathToUnixSeparators()` + `fs::exists()`; that result is cached too.
+	//
+	// NOTE: on case-insensitive filesystems (Windows, macOS) a name missing from a listing may still exist in another case,
+	// so on those platforms a listing is only trusted for the hits, never for the misses, and the lookups before the
+	// directory is listed take the (cached) slow path.
+	//
+	// The cache is never refreshed behind your back: when files are created or removed, or the current working directory
+	// changes, call `invalidate()`.
+	//
+	// NOTE: the cache is NOT thread-safe.
+	class FileLookupCache {
+	public:
+		FileLookupCache();
+
+		// a directory is scanned once it has been probed this many times: scanning a huge directory for only a few files is a loss.
+		unsigned listing_threshold = 8;
+
+		// the cached `fs::current_path()`
+		const path &current_path() const noexcept {
+			return _cwd;
+		}
+
+		// returns the normalized path, as produced by `NormalizePathToUnixSeparators()`, when the raw, absolute,
+		// `candidate` path exists.
+		std::optional<path> probe(const path &candidate);
+
+		// forget everything.
+		void invalidate();
+		// forget everything about this directory.
+		void invalidate(const path &directory);
+
+	protected:
+		enum class EntryKind : uint8_t {
+			Missing = 0,
+			Plain,
+			Symlink,
+		};
+
+		struct DirectoryInfo {
+			path normalized;			// NormalizePathToUnixSeparators() of the directory
+			bool is_directory = false;
+			bool listed = false;
+			unsigned probe_count = 0;
+			std::unordered_map<std::string, EntryKind> entries;
+		};
+
+#if defined(_WIN32) || defined(__APPLE__)
+		static constexpr const bool case_sensitive_names = false;
+#else
+		static constexpr const bool case_sensitive_names = true;
+#endif
+
+		DirectoryInfo &directory(const path &dir);
+		std::optional<path> probe_the_slow_way(const path &candidate);
+
+		path _cwd;
+
+		// keyed by the raw (not normalized) directory path
+		std::unordered_map<std::string, DirectoryInfo> _directories;
+
+		// the outcome of the slow path, keyed by the raw candidate path; an empty path means: does not exist.
+		std::unordered_map<std::string, path> _slow_results;
+	};
+
+}
@@ -1,37 +1,51 @@
 
 #include "Base.hpp"
+#include "FileLookupCache.hpp"
 
 namespace text_processing {
 
 	namespace fs = std::filesystem;
 
-	std::expected<path, ErrorResponse> locateFile(const path &filepath, const path &source_filepath, const searchPaths& search_paths, bool specfile_path_is_also_search_path, bool accept_absolute_paths, bool accept_relative_paths) {
+	std::expected<path, ErrorResponse> locateFile(const path &filepath, const path &source_filepath, const searchPaths& search_paths, bool specfile_path_is_also_search_path, bool accept_absolute_paths, bool accept_relative_paths, FileLookupCache *lookup_cache) {
 		if (filepath.is_relative()) {
-			path cwd = fs::current_path();
+			path cwd = (lookup_cache ? lookup_cache->current_path() : fs::current_path());
 
 			if (!accept_relative_paths) {
 				return std::unexpected{ErrorResponse{std::errc::invalid_argument, std::format("relative paths, such as file/path \"{}\", are not accepted.", filepath.generic_string())}};
 			}
 
-			// apply search path:
-			if (!specfile_path_is_also_search_path || source_filepath.empty()) {
-				path f = ConvertToAbsoluteNormalizedPath(filepath, cwd, cwd);
+			// check whether `filepath` exists in the given base directory; produces the normalized path when it does.
+			auto probe = [&](const path &base_filepath) -> std::optional<path> {
+				if (lookup_cache) {
+					// feed the cache the raw path; it does the normalizing itself, once per directory.
+					path f = (base_filepath.empty() ? filepath : base_filepath / filepath);
+					if (f.is_relative()) {
+						f = cwd / f;
+					}
+					return lookup_cache->probe(f);
+				}
+				path f = ConvertToAbsoluteNormalizedPath(filepath, base_filepath, cwd);
 				if (std::filesystem::exists(f)) {
 					return f;
 				}
+				return std::nullopt;
+			};
+
+			// apply search path:
+			if (!specfile_path_is_also_search_path || source_filepath.empty()) {
+				if (auto f = probe(cwd)) {
+					return f.value();
+				}
 			}
 			else if (specfile_path_is_also_search_path && filepath != source_filepath) {
-				path f = ConvertToAbsoluteNormalizedPath(filepath, source_filepath.parent_path(), cwd);
-				if (std::filesystem::exists(f)) {
-					return f;
+				if (auto f = probe(source_filepath.parent_path())) {
+					return f.value();
 				}
 			}
 
 			for (int i = 0, l = search_paths.size(); i < l; i++) {
-				path f = search_paths[i];
-				f = ConvertToAbsoluteNormalizedPath(filepath, f, cwd);
-				if (std::filesystem::exists(f)) {
-					return f;
+				if (auto f = probe(search_paths[i])) {
+					return f.value();
 				}
 			}
 
@@ -44,9 +58,15 @@ namespace text_processing {
 			return std::unexpected{ErrorResponse{std::errc::invalid_argument, std::format("absolute paths, such as file/path \"{}\", are not accepted.", filepath.generic_string())}};
 		}
 
-		path f = ConvertToAbsoluteNormalizedPath(filepath, {}, {});
-		if (std::filesystem::exists(f)) {
-			return f;
+		if (lookup_cache) {
+			if (auto f = lookup_cache->probe(filepath)) {
+				return f.value();
+			}
+		} else {
+			path f = ConvertToAbsoluteNormalizedPath(filepath, {}, {});
+			if (std::filesystem::exists(f)) {
+				return f;
+			}
 		}
 
 		//ErrorResponse e{std::errc::no_such_file_or_directory, std::format("file \"{}\" does not exist.", filepath.generic_string())};
@@ -55,4 +75,3 @@ namespace text_processing {
 	}
 
 }
-
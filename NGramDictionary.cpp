@@ -0,0 +1,186 @@
+#include "NGramDictionary.hpp"
+
+#include <string.h>
+#include <bit>
+
+
+namespace text_processing {
+
+	static constexpr const size_t initial_table_size = 1024;		// MUST be a power of 2
+
+	static inline uint64_t mix64(uint64_t h) noexcept {
+		// the murmur3 / splitmix finalizer
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	NGramDictionary::NGramDictionary(unsigned ngram_size) :
+		_ngram_size(std::clamp(ngram_size, 1U, max_ngram_size)) {
+	}
+
+	void NGramDictionary::reserve(size_t word_count, size_t ngram_count) {
+		_word_spans.reserve(word_count);
+		// heuristic: ~ 8 characters per unique word.
+		_word_chars.reserve(word_count * 8);
+		_ngram_words.reserve(ngram_count * _ngram_size);
+
+		// keep the load factor of the hash tables at or below 50%:
+		auto table_size_for = [](size_t count) -> size_t {
+			return std::bit_ceil(std::max(initial_table_size, count * 2));
+		};
+		if (_word_table.size() < table_size_for(word_count)) {
+			rehash_table(_word_table, table_size_for(word_count));
+		}
+		if (_ngram_table.size() < table_size_for(ngram_count)) {
+			rehash_table(_ngram_table, table_size_for(ngram_count));
+		}
+	}
+
+	void NGramDictionary::clear() noexcept {
+		_word_chars.clear();
+		_word_spans.clear();
+		_word_table.clear();
+		_ngram_words.clear();
+		_ngram_table.clear();
+	}
+
+	// as we keep the full hash in each slot, rehashing never touches the keys themselves.
+	void NGramDictionary::rehash_table(std::vector<Slot> &table, size_t new_size) {
+		std::vector<Slot> t(std::move(table));
+		table.assign(new_size, Slot{0, 0});
+		const size_t mask = new_size - 1;
+		for (const auto &s : t) {
+			if (s.id_plus_one) {
+				size_t i = s.hash & mask;
+				while (table[i].id_plus_one)
+					i = (i + 1) & mask;
+				table[i] = s;
+			}
+		}
+	}
+
+	uint32_t NGramDictionary::hash_word(std::string_view word) noexcept {
+		const char *p = word.data();
+		size_t l = word.size();
+		uint64_t h = 0x9e3779b97f4a7c15ULL ^ l;
+		// words are short: hash them 8 bytes at a time.
+		while (l >= 8) {
+			uint64_t v;
+			memcpy(&v, p, 8);
+			h = mix64(h ^ v);
+			p += 8;
+			l -= 8;
+		}
+		if (l) {
+			uint64_t v = 0;
+			memcpy(&v, p, l);
+			h = mix64(h ^ v);
+		}
+		return uint32_t(h ^ (h >> 32));
+	}
+
+	uint32_t NGramDictionary::hash_ngram(const word_id_t *word_ids) const noexcept {
+		uint64_t h = 0x9e3779b97f4a7c15ULL;
+		for (unsigned i = 0; i < _ngram_size; i++) {
+			h = (h ^ word_ids[i]) * 0xff51afd7ed558ccdULL;
+			h ^= h >> 29;
+		}
+		h = mix64(h);
+		return uint32_t(h ^ (h >> 32));
+	}
+
+	NGramDictionary::word_id_t NGramDictionary::intern_word(std::string_view word, std::error_code &ec) {
+		ec.clear();
+
+		if (_word_spans.size() * 2 >= _word_table.size()) {
+			rehash_table(_word_table, std::max(initial_table_size, _word_table.size() * 2));
+		}
+
+		const uint32_t h = hash_word(word);
+		const size_t mask = _word_table.size() - 1;
+		size_t i = h & mask;
+		for (;;) {
+			const Slot &s = _word_table[i];
+			if (!s.id_plus_one)
+				break;
+			if (s.hash == h) {
+				const WordSpan &w = _word_spans[s.id_plus_one - 1];
+				if (w.length == word.size() && memcmp(_word_chars.data() + w.offset, word.data(), word.size()) == 0) {
+					return s.id_plus_one - 1;
+				}
+			}
+			i = (i + 1) & mask;
+		}
+
+		// new word: append it to the character pool.
+		if (_word_spans.size() >= UINT32_MAX - 1 || _word_chars.size() + word.size() > UINT32_MAX) {
+			ec = std::make_error_code(std::errc::value_too_large);
+			return 0;
+		}
+		const word_id_t id = word_id_t(_word_spans.size());
+		_word_spans.push_back(WordSpan{uint32_t(_word_chars.size()), uint32_t(word.size())});
+		_word_chars.insert(_word_chars.end(), word.begin(), word.end());
+		_word_table[i] = Slot{h, id + 1};
+		return id;
+	}
+
+	NGramDictionary::ngram_id_t NGramDictionary::intern_ngram(const word_id_t *word_ids, std::error_code &ec) {
+		ec.clear();
+
+		const size_t count = size();
+		if (count * 2 >= _ngram_table.size()) {
+			rehash_table(_ngram_table, std::max(initial_table_size, _ngram_table.size() * 2));
+		}
+
+		const uint32_t h = hash_ngram(word_ids);
+		const size_t mask = _ngram_table.size() - 1;
+		const size_t keysize = _ngram_size * sizeof(word_id_t);
+		size_t i = h & mask;
+		for (;;) {
+			const Slot &s = _ngram_table[i];
+			if (!s.id_plus_one)
+				break;
+			if (s.hash == h && memcmp(_ngram_words.data() + size_t(s.id_plus_one - 1) * _ngram_size, word_ids, keysize) == 0) {
+				return s.id_plus_one - 1;
+			}
+			i = (i + 1) & mask;
+		}
+
+		if (count >= UINT32_MAX - 1) {
+			ec = std::make_error_code(std::errc::value_too_large);
+			return 0;
+		}
+		const ngram_id_t id = ngram_id_t(count);
+		_ngram_words.insert(_ngram_words.end(), word_ids, word_ids + _ngram_size);
+		_ngram_table[i] = Slot{h, id + 1};
+		return id;
+	}
+
+	std::string_view NGramDictionary::word(word_id_t id) const noexcept {
+		if (id >= _word_spans.size())
+			return {};
+		const WordSpan &w = _word_spans[id];
+		return std::string_view(_word_chars.data() + w.offset, w.length);
+	}
+
+	std::span<const NGramDictionary::word_id_t> NGramDictionary::ngram_words(ngram_id_t id) const noexcept {
+		if (id >= size())
+			return {};
+		return std::span<const word_id_t>(_ngram_words.data() + size_t(id) * _ngram_size, _ngram_size);
+	}
+
+	std::string NGramDictionary::ngram_text(ngram_id_t id, char separator) const {
+		std::string rv;
+		for (auto w : ngram_words(id)) {
+			if (!rv.empty())
+				rv += separator;
+			rv += word(w);
+		}
+		return rv;
+	}
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Base.hpp"
+
+#include <cstdint>
+#include <span>
+
+
+namespace text_processing {
+
+	// Interns words and word n-grams into compact 32-bit ids.
+	//
+	// This is the storage behind `ExtendedFileContent::parseContentAsNGrams()`: each n-gram is stored exactly once,
+	// as a run of `ngram_size()` word ids in one flat array, so adding an n-gram never costs a heap allocation of its own;
+	// all storage is amortized in a handful of growing vectors.
+	//
+	// The word texts are copied into the dictionary's own character pool, hence a single dictionary can be shared
+	// among many `ExtendedFileContent` instances (files) and outlive them all: that's what you want for near-duplicate
+	// detection across a corpus, where identical n-grams in different files MUST map to identical ids.
+	//
+	// NOTE: the dictionary is NOT thread-safe: do not feed it from multiple threads at the same time.
+	class NGramDictionary {
+	public:
+		typedef uint32_t word_id_t;
+		typedef uint32_t ngram_id_t;
+
+		static constexpr const unsigned max_ngram_size = 16;
+
+		explicit NGramDictionary(unsigned ngram_size = 3);
+
+		NGramDictionary(const NGramDictionary &) = default;
+		NGramDictionary(NGramDictionary &&) = default;
+		NGramDictionary &operator=(const NGramDictionary &) = default;
+		NGramDictionary &operator=(NGramDictionary &&) = default;
+
+		constexpr unsigned ngram_size() const noexcept {
+			return _ngram_size;
+		}
+
+		// number of unique words
+		size_t word_count() const noexcept {
+			return _word_spans.size();
+		}
+
+		// number of unique n-grams
+		size_t size() const noexcept {
+			return _ngram_words.size() / _ngram_size;
+		}
+
+		void reserve(size_t word_count, size_t ngram_count);
+		void clear() noexcept;
+
+		// returns the id of the given word, adding it to the dictionary when it isn't known yet.
+		//
+		// Sets `ec` (and returns 0) when the dictionary has run out of ids or character space.
+		word_id_t intern_word(std::string_view word, std::error_code &ec);
+
+		// returns the id of the n-gram formed by the `ngram_size()` word ids starting at `word_ids`, adding it to the
+		// dictionary when it isn't known yet.
+		ngram_id_t intern_ngram(const word_id_t *word_ids, std::error_code &ec);
+
+		std::string_view word(word_id_t id) const noexcept;
+
+		std::span<const word_id_t> ngram_words(ngram_id_t id) const noexcept;
+
+		// diagnostics: reconstructs the n-gram as text, its words separated by `separator`.
+		std::string ngram_text(ngram_id_t id, char separator = ' ') const;
+
+	protected:
+		struct WordSpan {
+			uint32_t offset;
+			uint32_t length;
+		};
+
+		// open addressing hash tables: each slot carries `id + 1`, zero marks an empty slot.
+		// The full hash is kept alongside so that most mismatches are rejected without touching the key data.
+		struct Slot {
+			uint32_t hash;
+			uint32_t id_plus_one;
+		};
+
+		static uint32_t hash_word(std::string_view word) noexcept;
+		uint32_t hash_ngram(const word_id_t *word_ids) const noexcept;
+
+		static void rehash_table(std::vector<Slot> &table, size_t new_size);
+
+		unsigned _ngram_size;
+
+		std::vector<char> _word_chars;
+		std::vector<WordSpan> _word_spans;
+		std::vector<Slot> _word_table;
+
+		// n-gram #i is stored as the word ids at [i * _ngram_size .. (i + 1) * _ngram_size)
+		std::vector<word_id_t> _ngram_words;
+		std::vector<Slot> _ngram_table;
+	};
+
+}
@@ -27,3 +27,44 @@ typedef unsigned char BYTE;
 #endif //~ _MSC_VER
 
 #endif
+
+
+// SIMD support: the x86-64 code paths are selected at run-time, so the library still runs on older hardware.
+#if defined(__x86_64__) || defined(_M_X64)
+#define TEXT_PROCESSING_HAS_X86_64_SIMD  1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+// GCC/clang require per-function target attributes for anything beyond the baseline ISA; MSVC doesn't care.
+#if defined(__GNUC__) || defined(__clang__)
+#define TEXT_PROCESSING_TARGET(isa)   __attribute__((target(isa)))
+#else
+#define TEXT_PROCESSING_TARGET(isa)
+#endif
+
+namespace text_processing {
+
+	// run-time CPU feature detection for the SIMD code paths. SSE2 is part of the x86-64 baseline, so we only need to ask about AVX2.
+	static inline bool cpu_has_avx2(void) {
+#if defined(TEXT_PROCESSING_HAS_X86_64_SIMD) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		// the OS must save the YMM registers on context switch (OSXSAVE + XCR0 bits 1,2) too:
+		if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return !!(info[1] & (1 << 5));
+#elif defined(TEXT_PROCESSING_HAS_X86_64_SIMD)
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+
+}
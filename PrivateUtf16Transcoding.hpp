@@ -0,0 +1,154 @@
+#pragma once
+
+#include "PrivateIntrinsics.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// UTF-16 (LE/BE) to UTF-8 transcoding straight into a destination buffer, which MAY be the source buffer itself:
+// `cleanRawDataIntoText()` (RawTextIngest) rewrites its input buffer in place.
+
+namespace text_processing {
+
+	enum class Utf16ByteOrder : uint8_t {
+		LittleEndian = 0,
+		BigEndian,
+	};
+
+	// is this a byte which can be expected in the ASCII part of text? (Printable ASCII plus the usual whitespace.)
+	static inline bool is_plausible_utf16_ascii_byte(uint8_t c) {
+		return (c >= 32 && c < 127) || c == '\n' || c == '\r' || c == '\t';
+	}
+
+	// recognize a UTF-16 byte order mark at `src`; returns its length (2) or 0.
+	static inline size_t utf16_bom_length(const uint8_t *src, size_t len, Utf16ByteOrder &order) {
+		if (len >= 2) {
+			if (src[0] == 0xFF && src[1] == 0xFE) {
+				order = Utf16ByteOrder::LittleEndian;
+				return 2;
+			}
+			if (src[0] == 0xFE && src[1] == 0xFF) {
+				order = Utf16ByteOrder::BigEndian;
+				return 2;
+			}
+		}
+		return 0;
+	}
+
+	// heuristic for UTF-16 without BOM: expect at least TWO ASCII characters as the leading part of the sequence.
+	static inline bool looks_like_utf16(const uint8_t *src, size_t len, Utf16ByteOrder order) {
+		if (len < 4)
+			return false;
+		if (order == Utf16ByteOrder::LittleEndian)
+			return src[1] == 0 && src[3] == 0 && is_plausible_utf16_ascii_byte(src[0]) && is_plausible_utf16_ascii_byte(src[2]);
+		return src[0] == 0 && src[2] == 0 && is_plausible_utf16_ascii_byte(src[1]) && is_plausible_utf16_ascii_byte(src[3]);
+	}
+
+	struct Utf16TranscodeResult {
+		size_t consumed;		// source bytes (always an even number)
+		size_t written;			// UTF-8 bytes
+	};
+
+	// transcode the UTF-16 code units at `src` to UTF-8 at `dst`, until a NUL code unit (which is not consumed), the
+	// end of the input, or a full output buffer. Surrogate pairs are combined; lone surrogates become U+FFFD. A high
+	// surrogate at the very end of the input is left alone: its partner may be in the next chunk of input.
+	//
+	// `dst` may point into the source buffer, at or before `src`: as UTF-8 can take 3 bytes where UTF-16 took 2, the
+	// output then MAY catch up with the unread input, in which case we stop right there, before any damage is done.
+	// Pure ASCII and 2-byte UTF-8 never get us into that kind of trouble.
+	static inline Utf16TranscodeResult transcode_utf16_to_utf8(const uint8_t *src, size_t srclen, Utf16ByteOrder order, uint8_t *dst, size_t dstsize) {
+		// in place? then the output must stay behind the read position: w + n <= gap + (read position after the unit).
+		const uintptr_t src_addr = reinterpret_cast<uintptr_t>(src);
+		const uintptr_t dst_addr = reinterpret_cast<uintptr_t>(dst);
+		const bool in_place = (dst_addr <= src_addr && src_addr < dst_addr + dstsize);
+		const size_t gap = (in_place ? src_addr - dst_addr : 0);
+		const bool big_endian = (order == Utf16ByteOrder::BigEndian);
+
+		auto code_unit = [src, big_endian](size_t r) -> uint32_t {
+			return big_endian ? (uint32_t(src[r]) << 8) | src[r + 1] : (uint32_t(src[r + 1]) << 8) | src[r];
+		};
+
+		size_t r = 0;
+		size_t w = 0;
+		for (;;) {
+#if defined(TEXT_PROCESSING_HAS_X86_64_SIMD)
+			// the common case: ASCII in UTF-16. 16 code units at a time go through a saturating pack; any code unit
+			// outside 0x0001..0x007F ends up as either NUL or a byte >= 0x80 in the packed result.
+			//
+			// In place, the output lags behind the input (w <= gap + r), so the 16-byte store never reaches the unread part.
+			while (r + 32 <= srclen && w + 16 <= dstsize) {
+				__m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + r));
+				__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + r + 16));
+				if (big_endian) {
+					v0 = _mm_or_si128(_mm_srli_epi16(v0, 8), _mm_slli_epi16(v0, 8));
+					v1 = _mm_or_si128(_mm_srli_epi16(v1, 8), _mm_slli_epi16(v1, 8));
+				}
+				const __m128i packed = _mm_packus_epi16(v0, v1);
+				if (_mm_movemask_epi8(packed) | _mm_movemask_epi8(_mm_cmpeq_epi8(packed, _mm_setzero_si128())))
+					break;
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + w), packed);
+				r += 32;
+				w += 16;
+			}
+#endif
+
+			// one block's worth of code units the hard way, then try the fast path again.
+			for (int k = 0; k < 16; k++) {
+				if (r + 2 > srclen)
+					return {r, w};
+				const uint32_t cu = code_unit(r);
+				if (cu == 0)
+					return {r, w};
+
+				uint32_t cp = cu;
+				size_t units = 1;
+				if (cu >= 0xD800 && cu < 0xDC00) {
+					// high surrogate: a low surrogate must follow.
+					if (r + 4 > srclen)
+						return {r, w};
+					const uint32_t cu2 = code_unit(r + 2);
+					if (cu2 >= 0xDC00 && cu2 < 0xE000) {
+						// https://en.wikipedia.org/wiki/UTF-16
+						cp = 0x10000 + ((cu - 0xD800) << 10) + (cu2 - 0xDC00);
+						units = 2;
+					} else {
+						cp = 0xFFFD;
+					}
+				} else if (cu >= 0xDC00 && cu < 0xE000) {
+					// unexpected low surrogate
+					cp = 0xFFFD;
+				}
+
+				const size_t n = (cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4);
+				const size_t r_next = r + 2 * units;
+				if (w + n > dstsize || (in_place && w + n > gap + r_next))
+					return {r, w};
+
+				uint8_t *d = dst + w;
+				switch (n) {
+				case 1:
+					d[0] = uint8_t(cp);
+					break;
+				case 2:
+					d[0] = uint8_t(0xC0 | (cp >> 6));
+					d[1] = uint8_t(0x80 | (cp & 0x3F));
+					break;
+				case 3:
+					d[0] = uint8_t(0xE0 | (cp >> 12));
+					d[1] = uint8_t(0x80 | ((cp >> 6) & 0x3F));
+					d[2] = uint8_t(0x80 | (cp & 0x3F));
+					break;
+				default:
+					d[0] = uint8_t(0xF0 | (cp >> 18));
+					d[1] = uint8_t(0x80 | ((cp >> 12) & 0x3F));
+					d[2] = uint8_t(0x80 | ((cp >> 6) & 0x3F));
+					d[3] = uint8_t(0x80 | (cp & 0x3F));
+					break;
+				}
+				w += n;
+				r = r_next;
+			}
+		}
+	}
+
+}
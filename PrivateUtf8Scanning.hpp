@@ -0,0 +1,249 @@
+#pragma once
+
+#include "PrivateIntrinsics.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// Vectorized scanning of raw (file) data which is expected to be mostly ASCII with the sporadic UTF-8 sequence in
+// between: the fast path for `cleanRawDataIntoText()` (RawTextIngest).
+
+namespace text_processing {
+
+	// does the byte pass through the raw data cleaners unchanged? Printable ASCII, TAB and LF do; all other control
+	// characters, DEL and anything >= 0x80 (which needs UTF-8 validation) do not.
+	static inline bool is_verbatim_ascii_byte(uint8_t c) {
+		return (c >= 32 && c < 127) || c == '\n' || c == '\t';
+	}
+
+	// step back from `p` to the start of any UTF-8 sequence that straddles `p`, so we never split a multibyte
+	// sequence when we hand over to the scalar code.
+	static inline size_t utf8_char_boundary_at_or_before(const uint8_t *src, size_t p) {
+		for (size_t k = 1; k <= 3 && k <= p; k++) {
+			const uint8_t c = src[p - k];
+			if ((c & 0xC0) != 0x80) {
+				// the lead byte (or ASCII): does its sequence extend to `p` or beyond?
+				const size_t seqlen = (c < 0xC0 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4);
+				return (seqlen > k ? p - k : p);
+			}
+		}
+		return p;
+	}
+
+	// the portable fallback: no bulk skipping at all, every byte goes through the scalar path.
+	[[maybe_unused]] static inline size_t utf8_verbatim_span_scalar(const uint8_t *src, size_t len) {
+		size_t i = 0;
+		while (i < len && is_verbatim_ascii_byte(src[i])) {
+			i++;
+		}
+		return i;
+	}
+
+#if defined(TEXT_PROCESSING_HAS_X86_64_SIMD)
+
+	// bytes < 0x20 except TAB and LF, plus DEL: those the cleaners rewrite.
+	static inline __m128i control_bytes_sse2(__m128i v) {
+		const __m128i below_space = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+		const __m128i tab_or_lf = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+		return _mm_or_si128(_mm_andnot_si128(tab_or_lf, below_space), _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+	}
+
+	// SSE2 has no byte shuffle, hence no lookup tables: skip pure-ASCII 16-byte blocks and stop at the first byte
+	// which needs a closer look, UTF-8 lead bytes included.
+	static inline size_t utf8_verbatim_span_sse2(const uint8_t *src, size_t len) {
+		size_t i = 0;
+		for (; i + 16 <= len; i += 16) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+			const uint32_t stop = static_cast<uint32_t>(_mm_movemask_epi8(v) | _mm_movemask_epi8(control_bytes_sse2(v)));
+			if (stop) {
+				return i + std::countr_zero(stop);
+			}
+		}
+		return i;
+	}
+
+	TEXT_PROCESSING_TARGET("avx2")
+	static inline __m256i control_bytes_avx2(__m256i v) {
+		const __m256i below_space = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v);
+		const __m256i tab_or_lf = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+		return _mm256_or_si256(_mm256_andnot_si256(tab_or_lf, below_space), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F)));
+	}
+
+	// `v` shifted right by N bytes across the full 256 bits, the gap filled from the tail end of `prev`.
+	template <int N>
+	TEXT_PROCESSING_TARGET("avx2")
+	static inline __m256i prev_bytes_avx2(__m256i v, __m256i prev) {
+		return _mm256_alignr_epi8(v, _mm256_permute2x128_si256(prev, v, 0x21), 16 - N);
+	}
+
+	// UTF-8 validation by table lookup (Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte",
+	// as used by simdjson): the high and low nibble of each byte plus the high nibble of the byte following it are
+	// mapped to sets of potential errors; when all three lookups agree on an error, there is one. The 3rd/4th byte
+	// continuation checks are done separately. A non-zero byte in the result flags an error at that position.
+	//
+	// NOTE: this is stricter than `fz_chartorune()`, which accepts surrogates and code points up to 0x1FFFFF: those
+	// are left for the scalar path to deal with, so the output doesn't change.
+	TEXT_PROCESSING_TARGET("avx2")
+	static inline __m256i utf8_errors_avx2(__m256i input, __m256i prev_input) {
+		constexpr const uint8_t TOO_SHORT = 1 << 0;		// 11______ 0_______ or 11______ 11______
+		constexpr const uint8_t TOO_LONG = 1 << 1;		// 0_______ 10______
+		constexpr const uint8_t OVERLONG_3 = 1 << 2;	// 11100000 100_____
+		constexpr const uint8_t TOO_LARGE = 1 << 3;		// 11110100 1001____ and up
+		constexpr const uint8_t SURROGATE = 1 << 4;		// 11101101 101_____
+		constexpr const uint8_t OVERLONG_2 = 1 << 5;	// 1100000_ 10______
+		constexpr const uint8_t TOO_LARGE_1000 = 1 << 6;	// 11110101+ 1000____
+		constexpr const uint8_t OVERLONG_4 = 1 << 6;	// 11110000 1000____
+		constexpr const uint8_t TWO_CONTS = 1 << 7;		// 10______ 10______
+		constexpr const uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+		const __m256i byte_1_high_table = _mm256_setr_epi8(
+			// 0_______ ________ <ASCII in byte 1>
+			TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+			// 10______ ________ <continuation in byte 1>
+			TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+			// 1100____ ________ <two byte lead in byte 1>
+			TOO_SHORT | OVERLONG_2,
+			// 1101____ ________ <two byte lead in byte 1>
+			TOO_SHORT,
+			// 1110____ ________ <three byte lead in byte 1>
+			TOO_SHORT | OVERLONG_3 | SURROGATE,
+			// 1111____ ________ <four+ byte lead in byte 1>
+			char(TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4),
+			// (both 128-bit lanes carry the same table)
+			TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+			TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+			TOO_SHORT | OVERLONG_2,
+			TOO_SHORT,
+			TOO_SHORT | OVERLONG_3 | SURROGATE,
+			char(TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4));
+
+		const __m256i byte_1_low_table = _mm256_setr_epi8(
+			// ____0000 ________
+			char(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+			// ____0001 ________
+			char(CARRY | OVERLONG_2),
+			// ____001_ ________
+			char(CARRY), char(CARRY),
+			// ____0100 ________
+			char(CARRY | TOO_LARGE),
+			// ____0101 ________ and up
+			char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			// ____1101 ________
+			char(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+			char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			// (both 128-bit lanes carry the same table)
+			char(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+			char(CARRY | OVERLONG_2),
+			char(CARRY), char(CARRY),
+			char(CARRY | TOO_LARGE),
+			char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+			char(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+			char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000));
+
+		const __m256i byte_2_high_table = _mm256_setr_epi8(
+			// ________ 0_______ <ASCII in byte 2>
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+			// ________ 1000____
+			char(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+			// ________ 1001____
+			char(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+			// ________ 101_____
+			char(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE), char(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+			// ________ 11______
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+			// (both 128-bit lanes carry the same table)
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+			char(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+			char(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+			char(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE), char(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+			TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+		const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+		const __m256i prev1 = prev_bytes_avx2<1>(input, prev_input);
+
+		const __m256i byte_1_high = _mm256_shuffle_epi8(byte_1_high_table, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble_mask));
+		const __m256i byte_1_low = _mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(prev1, nibble_mask));
+		const __m256i byte_2_high = _mm256_shuffle_epi8(byte_2_high_table, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble_mask));
+		const __m256i special_cases = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+		// the 3rd and 4th byte of a 3/4 byte sequence must be continuations; the lookup above flagged them as TWO_CONTS.
+		const __m256i prev2 = prev_bytes_avx2<2>(input, prev_input);
+		const __m256i prev3 = prev_bytes_avx2<3>(input, prev_input);
+		const __m256i is_third_byte = _mm256_subs_epu8(prev2, _mm256_set1_epi8(char(0xE0 - 0x80)));
+		const __m256i is_fourth_byte = _mm256_subs_epu8(prev3, _mm256_set1_epi8(char(0xF0 - 0x80)));
+		const __m256i must23_80 = _mm256_and_si256(_mm256_or_si256(is_third_byte, is_fourth_byte), _mm256_set1_epi8(char(0x80)));
+		return _mm256_xor_si256(must23_80, special_cases);
+	}
+
+	// does the block end with an incomplete multibyte sequence? (non-zero when it does)
+	TEXT_PROCESSING_TARGET("avx2")
+	static inline __m256i utf8_incomplete_avx2(__m256i input) {
+		const __m256i max_value = _mm256_setr_epi8(
+			char(255), char(255), char(255), char(255), char(255), char(255), char(255), char(255),
+			char(255), char(255), char(255), char(255), char(255), char(255), char(255), char(255),
+			char(255), char(255), char(255), char(255), char(255), char(255), char(255), char(255),
+			char(255), char(255), char(255), char(255), char(255), char(0xF0 - 1), char(0xE0 - 1), char(0xC0 - 1));
+		return _mm256_subs_epu8(input, max_value);
+	}
+
+	// skip 32-byte blocks of printable ASCII and well-formed UTF-8 in bulk; stop at the start of the first character
+	// (ASCII or multibyte) which the scalar code must handle: control bytes, DEL and invalid/truncated sequences.
+	TEXT_PROCESSING_TARGET("avx2")
+	static inline size_t utf8_verbatim_span_avx2(const uint8_t *src, size_t len) {
+		__m256i prev_input = _mm256_setzero_si256();
+		__m256i prev_incomplete = _mm256_setzero_si256();
+
+		size_t i = 0;
+		for (; i + 32 <= len; i += 32) {
+			const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+			uint32_t stop = static_cast<uint32_t>(_mm256_movemask_epi8(control_bytes_avx2(input)));
+			if (_mm256_movemask_epi8(input) == 0) {
+				// pure ASCII: nothing to validate, unless the previous block left a multibyte sequence dangling.
+				if (!_mm256_testz_si256(prev_incomplete, prev_incomplete)) {
+					stop |= 1;
+				}
+				prev_incomplete = _mm256_setzero_si256();
+			} else {
+				const __m256i errors = utf8_errors_avx2(input, prev_input);
+				stop |= ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(errors, _mm256_setzero_si256())));
+				prev_incomplete = utf8_incomplete_avx2(input);
+			}
+			if (stop) {
+				// all bytes before the first flagged one are fine, but the sequence it belongs to may have started earlier.
+				return utf8_char_boundary_at_or_before(src, i + std::countr_zero(stop));
+			}
+			prev_input = input;
+		}
+		// don't run off with the first part of a sequence which is completed in the tail end: the scalar code gets it all.
+		return utf8_char_boundary_at_or_before(src, i);
+	}
+
+#endif
+
+	using utf8_verbatim_span_f = size_t (*)(const uint8_t *src, size_t len);
+
+	static inline utf8_verbatim_span_f select_utf8_verbatim_span(void) {
+#if defined(TEXT_PROCESSING_HAS_X86_64_SIMD)
+		if (cpu_has_avx2()) {
+			return utf8_verbatim_span_avx2;
+		}
+		return utf8_verbatim_span_sse2;
+#else
+		return utf8_verbatim_span_scalar;
+#endif
+	}
+
+	// the length of the leading run of `src` which the raw data cleaners copy verbatim: printable ASCII, TAB, LF and
+	// (AVX2 only) well-formed UTF-8. The run always ends at a character boundary. It MAY stop short of what could be
+	// copied verbatim, e.g. in the last block of the input: it's a fast path, not the final word.
+	static inline size_t utf8_verbatim_span(const uint8_t *src, size_t len) {
+		static const utf8_verbatim_span_f scanner = select_utf8_verbatim_span();
+		return scanner(src, len);
+	}
+
+}
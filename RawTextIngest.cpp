@@ -0,0 +1,703 @@
+
+#include "RawTextIngest.hpp"
+#include "ReadFileContents.hpp"
+
+#include "PrivateUtf8Scanning.hpp"
+#include "PrivateUtf16Transcoding.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace text_processing {
+
+	void ProgressTimer::init(void) {
+		t = std::async(std::launch::async, &ProgressTimer::timer_task, this);
+	}
+
+	ProgressTimer::~ProgressTimer() {
+		must_stop = true;
+		if (t.valid()) {
+			t.wait();
+			(void)t.get();
+		}
+	}
+
+	int ProgressTimer::timer_task(void) {
+		using namespace std::chrono_literals;
+
+		ticked = true;
+
+		while (!must_stop) {
+			ticked = true;
+
+			std::this_thread::sleep_for(125ms);
+		}
+
+		ticked = true;
+
+		return 0;
+	}
+
+	void ProgressTimer::show_progress(void) {
+		auto triggered = ticked.exchange(false);
+		if (triggered) {
+			std::cerr << ".";
+		}
+	}
+
+	// ------------------------------------------------------------------------------------
+
+	// NOTE: this next part is a near-duplicate of the code in thirdparty/mujs/utf.c
+
+	typedef signed int Rune;	/* Code-point values in Unicode 4.0 are 21 bits wide.*/
+
+	enum
+	{
+		UTFmax	= 4,		/* maximum bytes per rune */
+		Runesync	= 0x80,		/* cannot represent part of a UTF sequence (<) */
+		Runeself	= 0x80,		/* rune and UTF sequences are the same (<) */
+		Runeerror	= 0xFFFD,	/* decoding error in UTF */
+		Runemax	= 0x10FFFF,	/* maximum rune value */
+	};
+
+	enum
+	{
+		Bit1 = 7,
+		Bitx = 6,
+		Bit2 = 5,
+		Bit3 = 4,
+		Bit4 = 3,
+		Bit5 = 2,
+
+		T1 = ((1<<(Bit1+1))-1) ^ 0xFF, /* 0000 0000 */
+		Tx = ((1<<(Bitx+1))-1) ^ 0xFF, /* 1000 0000 */
+		T2 = ((1<<(Bit2+1))-1) ^ 0xFF, /* 1100 0000 */
+		T3 = ((1<<(Bit3+1))-1) ^ 0xFF, /* 1110 0000 */
+		T4 = ((1<<(Bit4+1))-1) ^ 0xFF, /* 1111 0000 */
+		T5 = ((1<<(Bit5+1))-1) ^ 0xFF, /* 1111 1000 */
+
+		Rune1 = (1<<(Bit1+0*Bitx))-1, /* 0000 0000 0111 1111 */
+		Rune2 = (1<<(Bit2+1*Bitx))-1, /* 0000 0111 1111 1111 */
+		Rune3 = (1<<(Bit3+2*Bitx))-1, /* 1111 1111 1111 1111 */
+		Rune4 = (1<<(Bit4+3*Bitx))-1, /* 0001 1111 1111 1111 1111 1111 */
+
+		Maskx = (1<<Bitx)-1,	/* 0011 1111 */
+		Testx = Maskx ^ 0xFF,	/* 1100 0000 */
+
+		Bad = Runeerror,
+	};
+
+	static int
+	fz_chartorune(uint32_t *rune, const unsigned char *str, size_t n)
+	{
+		uint32_t c, c1, c2, c3;
+		uint32_t l;
+
+		/*
+		 * one character sequence
+		 *	00000-0007F => T1
+		 */
+		if (n < 1)
+			goto bad;
+		c = *str;
+		if (c < Tx) {
+			*rune = c;
+			return 1;
+		}
+
+		/*
+		 * two character sequence
+		 *	0080-07FF => T2 Tx
+		 */
+		if (n < 2)
+			goto bad;
+		c1 = *(str+1) ^ Tx;
+		if (c1 & Testx)
+			goto bad;
+		if (c < T3) {
+			if (c < T2)
+				goto bad;
+			l = ((c << Bitx) | c1) & Rune2;
+			if (l <= Rune1)
+				goto bad;
+			*rune = l;
+			return 2;
+		}
+
+		/*
+		 * three character sequence
+		 *	0800-FFFF => T3 Tx Tx
+		 */
+		if (n < 3)
+			goto bad;
+		c2 = *(str+2) ^ Tx;
+		if (c2 & Testx)
+			goto bad;
+		if (c < T4) {
+			l = ((((c << Bitx) | c1) << Bitx) | c2) & Rune3;
+			if (l <= Rune2)
+				goto bad;
+			*rune = l;
+			return 3;
+		}
+
+		/*
+		 * four character sequence (21-bit value)
+		 *	10000-1FFFFF => T4 Tx Tx Tx
+		 */
+		if (n < 4)
+			goto bad;
+		c3 = *(str+3) ^ Tx;
+		if (c3 & Testx)
+			goto bad;
+		if (c < T5) {
+			l = ((((((c << Bitx) | c1) << Bitx) | c2) << Bitx) | c3) & Rune4;
+			if (l <= Rune3)
+				goto bad;
+			*rune = l;
+			return 4;
+		}
+		/*
+		 * Support for 5-byte or longer UTF-8 would go here, but
+		 * since we don't have that, we'll just fall through to bad.
+		 */
+
+		 /*
+		  * bad decoding
+		  */
+	bad:
+		*rune = Bad;
+		return -1;
+	}
+
+	// the transcoded text gets the same treatment as everything else: control characters and DEL become LF.
+	static void clean_transcoded_text(uint8_t *text, size_t len) {
+		for (size_t k = 0; k < len; k++) {
+			const uint8_t c = text[k];
+			if ((c < 32 && c != '\n' && c != '\t') || c == 127)
+				text[k] = '\n';
+		}
+	}
+
+	// the remainder of the UTF-16 run at `src[start + consumed]` goes into `overflow`: see `transcode_utf16_run()`.
+	static void transcode_utf16_run_into_overflow(const uint8_t *src, size_t srcsize, size_t start, Utf16ByteOrder order, size_t &consumed, std::vector<uint8_t> &overflow) {
+		for (;;) {
+			const size_t at = overflow.size();
+			const size_t room = std::max<size_t>(4096, at);
+			overflow.resize(at + room);
+			auto [c, w] = transcode_utf16_to_utf8(src + start + consumed, srcsize - start - consumed, order, overflow.data() + at, room);
+			overflow.resize(at + w);
+			clean_transcoded_text(overflow.data() + at, w);
+			consumed += c;
+			// stopped for any other reason than a full output buffer? Then we've reached the end of the run.
+			if (w + UTFmax <= room)
+				break;
+		}
+	}
+
+	// transcode the UTF-16 text at `src[start]` in place, appending the UTF-8 to the output at `src[j]`.
+	// Returns the number of source bytes consumed; 0 when this didn't pan out after all.
+	//
+	// When the output catches up with the input (CJK and the like: 3 bytes of UTF-8 for 2 bytes of UTF-16), the
+	// remainder of the run is transcoded into `overflow` instead.
+	//
+	// When more raw data is to follow (`continued` is set) and the run lasts until the end of this lot, the run
+	// continues at the start of the next chunk: that's noted in `continued`.
+	static size_t transcode_utf16_run(uint8_t *src, size_t srcsize, size_t start, Utf16ByteOrder order, size_t &j, std::vector<uint8_t> &overflow, RawTextCleanupState *continued) {
+		auto [consumed, written] = transcode_utf16_to_utf8(src + start, srcsize - start, order, src + j, srcsize - j);
+		clean_transcoded_text(src + j, written);
+		j += written;
+
+		// the output can only have caught up when it's right up against the input.
+		if (j == start + consumed)
+			transcode_utf16_run_into_overflow(src, srcsize, start, order, consumed, overflow);
+
+		// at most an odd byte or a lone high surrogate left: those are for the next chunk to complete.
+		if (continued && srcsize - (start + consumed) < UTFmax) {
+			continued->utf16_run_active = true;
+			continued->utf16_big_endian = (order == Utf16ByteOrder::BigEndian);
+		}
+		return consumed;
+	}
+
+	//
+	// Given that we always have `raw_data_tail_size` nil bytes following the tail end of the input buffer, it is safe
+	// to look ahead that far or (if looking ahead further) until the next NUL byte.
+	//
+	// It is also safe to rewrite/destroy the input buffer in the space we will process.
+	//
+	RawTextCleanupResult cleanRawDataIntoText(uint8_t *src, size_t srcsize, bool forced_process_all, std::vector<uint8_t> &overflow, RawTextCleanupState &state) {
+		overflow.clear();
+		size_t j = 0;
+		size_t i = 0;
+		// the end of the last UTF-16 run we transcoded: its output doesn't map 1:1 onto its input.
+		size_t utf16_end = 0;
+		// the UTF-16 run we've been transcoding at the end of the previous chunk MAY be noted again at the end of this one.
+		RawTextCleanupState *continued = (forced_process_all ? nullptr : &state);
+
+		// pick up where the previous chunk left off: in the middle of a UTF-16 run?
+		if (state.utf16_run_active) {
+			state.utf16_run_active = false;
+			const Utf16ByteOrder order = (state.utf16_big_endian ? Utf16ByteOrder::BigEndian : Utf16ByteOrder::LittleEndian);
+			i = utf16_end = transcode_utf16_run(src, srcsize, 0, order, j, overflow, continued);
+			if (!overflow.empty() || state.utf16_run_active)
+				return {i, j};
+		}
+		while (i < srcsize) {
+			// fast path: printable ASCII and well-formed UTF-8 is copied in bulk; only the remainder is processed byte by byte / rune by rune.
+			if (size_t n = utf8_verbatim_span(src + i, srcsize - i); n > 0) {
+				if (j != i) {
+					memmove(src + j, src + i, n);
+				}
+				i += n;
+				j += n;
+				if (i >= srcsize)
+					break;
+			}
+
+			// more raw data to come? then leave what MAY be the start of a UTF-8 sequence or UTF-16 run for the next round.
+			if (!forced_process_all && srcsize - i < UTFmax)
+				break;
+
+			uint8_t c = src[i++];
+			if (c < 32) {
+				switch (c) {
+				default:
+					// convert all (undesirable) control characters to LF:
+					c = '\n';
+					break;
+
+				case 0: // --> detect UTF16 input (LE or BE, without BOM) and transcode it in place...
+					{
+						const size_t p = i - 1;
+						// LE: this NUL is the high byte of an ASCII code unit, whose low byte we've just passed: that one
+						// went to the output 1:1, so we back up a single byte there as well.
+						if (p > utf16_end && j > 0 && looks_like_utf16(src + p - 1, srcsize - p + 1, Utf16ByteOrder::LittleEndian)) {
+							size_t k = j - 1;
+							if (size_t len = transcode_utf16_run(src, srcsize, p - 1, Utf16ByteOrder::LittleEndian, k, overflow, continued); len > 0) {
+								j = k;
+								i = utf16_end = p - 1 + len;
+								if (!overflow.empty() || state.utf16_run_active)
+									return {i, j};
+								continue;
+							}
+						}
+						// BE: this NUL is the high byte of the first code unit.
+						if (looks_like_utf16(src + p, srcsize - p, Utf16ByteOrder::BigEndian)) {
+							if (size_t len = transcode_utf16_run(src, srcsize, p, Utf16ByteOrder::BigEndian, j, overflow, continued); len > 0) {
+								i = utf16_end = p + len;
+								if (!overflow.empty() || state.utf16_run_active)
+									return {i, j};
+								continue;
+							}
+						}
+					}
+
+					// treat as sentinel NUL ==> NL
+					c = '\n';
+					break;
+
+				case '\r':
+					c = '\n';
+					break;
+				case '\n':
+					break;
+				case '\t':
+					// c = ' ';
+					break;
+				}
+			} else if (c < 127) {
+				// ASCII: keep as is
+			} else if (c == 127) {
+				// DEL --> LF
+				c = '\n';
+			} else {
+				// c > 127: assume UTF8; it's NOT ASCII, anyway!
+
+				// UTF8 input expected/assumed.
+				uint32_t rune = 0;
+				i--;
+				// thanks to our tail we don't have to worry about underruns.
+				int l = fz_chartorune(&rune, src + i, srcsize - i);
+				if (l < 1) {
+					// a UTF-16 byte order mark? FF FE / FE FF are no valid UTF-8 anyway.
+					Utf16ByteOrder order;
+					if (size_t bom = utf16_bom_length(src + i, srcsize - i, order); bom > 0) {
+						// (right after the BOM, the run MAY well start in the next chunk.)
+						if (size_t len = transcode_utf16_run(src, srcsize, i + bom, order, j, overflow, continued); len > 0 || state.utf16_run_active) {
+							i = utf16_end = i + bom + len;
+							if (!overflow.empty() || state.utf16_run_active)
+								return {i, j};
+							continue;
+						}
+					}
+
+					// error => discard (non-ASCII, non-UTF8).
+					i++;
+					c = '\n';
+				} else {
+					// else: copy the UTF8 byte seq:
+					if (j != i) {
+						memmove(src + j, src + i, l);
+					}
+					// else: no need to move as &src[j] == &src[i]
+					j += l;
+					i += l;
+					continue;
+				}
+			}
+			src[j++] = c;
+		}
+
+		return {i, j};
+	}
+
+	// ------------------------------------------------------------------------------------
+
+	// load small-ish chunks of file content while keeping an eye on our progress ticker.
+	// Once we have a rough estimate how many chunks we could fetch between progress 'ticks',
+	// we update (increase) the chunk size to optimize reading from the file.
+	//
+	// This aims for a middle ground between maximum read buffering/speed and timely/smooth progress visual feedback.
+	//
+	// `read_some` reads up to N bytes and returns the number read, 0 at EOF.
+	template <class ReadSome>
+	static std::expected<size_t, ErrorResponse> read_with_progress(ReadSome &&read_some, ProgressTimer *progress, uint8_t *buf, size_t bufsize) {
+		uint8_t *ptr = buf;
+		uint8_t *endptr = buf + bufsize;
+		size_t spot_bufsize = (progress != nullptr ? 1024 : bufsize);
+		size_t spot_count = 1;
+
+		while (endptr > ptr) {
+			const size_t remainder = std::min<size_t>(endptr - ptr, spot_bufsize);
+			auto r = read_some(ptr, remainder);
+			if (!r.has_value())
+				return r;
+			ptr += r.value();
+
+			// show progress if requested
+			if (progress) {
+				if (!progress->tick()) {
+					spot_count++;
+				} else {
+					progress->show_progress();
+					spot_bufsize *= spot_count;
+					spot_count = 1;
+				}
+			}
+
+			if (r.value() < remainder)
+				break;
+		}
+		return ptr - buf;
+	}
+
+	RawTextIngest::RawTextIngest(size_t chunk_size) :
+		_chunk_size(std::max<size_t>(chunk_size, 64)) {
+	}
+
+	TextBuffer RawTextIngest::take_text() {
+		_text_length = 0;
+		_pending = 0;
+		return std::move(_text);
+	}
+
+	void RawTextIngest::reuse(TextBuffer &&buffer) {
+		_text = std::move(buffer);
+		// a file mapping cannot grow, so that one's no use to us.
+		if (_text.storage_kind() == TextBuffer::StorageKind::MemoryMapped)
+			_text.clear();
+		if (_text.capacity() > 0)
+			_text.set_content_size(0);
+		_text_length = 0;
+		_pending = 0;
+	}
+
+	std::optional<ErrorResponse> RawTextIngest::make_room(size_t amount) {
+		const size_t needed = _text_length + _pending + amount;
+		std::error_code ec;
+		if (_text.capacity() == 0) {
+			_text.reserve(needed, ec);
+		} else if (_text.capacity() < needed + TextBuffer::sentinel_size) {
+			// grow geometrically: stdin may keep feeding us for a while. A (pooled) buffer which holds no text yet
+			// is grown to size instead.
+			_text.grow(_text_length > 0 ? std::max(needed, _text.capacity() + _text.capacity() / 2) : needed, ec);
+		}
+		if (ec) {
+			return ErrorResponse{std::errc::not_enough_memory, std::format("failure while preparing buffer space ({}) for the text: error {}:{}", needed, ec.value(), ec.message())};
+		}
+		return std::nullopt;
+	}
+
+	template <class Reader>
+	std::optional<ErrorResponse> RawTextIngest::ingest_stream(Reader &&read, size_t size_hint) {
+		// don't allocate a full chunk for a small file.
+		const size_t chunk_size = (size_hint > 0 ? std::min(_chunk_size, size_hint + 1) : _chunk_size);
+		if (size_hint > chunk_size) {
+			if (auto e = make_room(size_hint + raw_data_tail_size))
+				return e;
+		}
+
+		size_t total_read = 0;
+		_cleanup_state = {};
+		for (;;) {
+			// don't read past the expected end of the file, bar a single byte to detect EOF: then the space we
+			// reserved up front will do. Only when the file has grown in the meantime do we read (and grow) on.
+			const size_t amount = (size_hint > total_read ? std::min(chunk_size, size_hint - total_read + 1) : chunk_size);
+			if (auto e = make_room(amount))
+				return e;
+
+			uint8_t *base = reinterpret_cast<uint8_t *>(_text.data()) + _text_length;
+			auto r = read(base + _pending, amount);
+			if (!r.has_value())
+				return r.error();
+			total_read += r.value();
+
+			// a short read means EOF: then we process everything, remaining bits & pieces included.
+			const bool eof = (r.value() < amount);
+			size_t raw = _pending + r.value();
+			// make_room() has the sentinel space covered.
+			memset(base + raw, 0, raw_data_tail_size);
+
+			for (;;) {
+				auto [consumed, written] = cleanRawDataIntoText(base, raw, eof, _overflow, _cleanup_state);
+				assert(written <= consumed);
+				if (_overflow.empty()) {
+					if (consumed < raw) {
+						// carry the unprocessed tail over into the next round: keep it right behind the text.
+						memmove(base + written, base + consumed, raw - consumed);
+					}
+					_text_length += written;
+					_pending = raw - consumed;
+					break;
+				}
+
+				// a UTF-16 run which didn't fit in place: move the remaining raw data out of the way, put the rest of
+				// the run's text in between and carry on with the remainder of the chunk.
+				const size_t text_start = _text_length;
+				_text_length += written;
+				_pending = raw - consumed;
+				if (auto e = make_room(_overflow.size() + raw_data_tail_size))
+					return e;
+				base = reinterpret_cast<uint8_t *>(_text.data()) + text_start;
+				memmove(base + written + _overflow.size(), base + consumed, _pending);
+				memcpy(base + written, _overflow.data(), _overflow.size());
+				_text_length += _overflow.size();
+				base = reinterpret_cast<uint8_t *>(_text.data()) + _text_length;
+				raw = _pending;
+				memset(base + raw, 0, raw_data_tail_size);
+			}
+
+			if (eof)
+				break;
+		}
+		assert(_pending == 0);
+
+		_text.set_content_size(_text_length);
+		_text.write_text_edge_sentinel();
+		return std::nullopt;
+	}
+
+	std::optional<ErrorResponse> RawTextIngest::ingest(FILE *fin, ProgressTimer *progress) {
+		return ingest_stream([fin, progress](uint8_t *dst, size_t amount) -> std::expected<size_t, ErrorResponse> {
+			return read_with_progress([fin](uint8_t *ptr, size_t n) -> std::expected<size_t, ErrorResponse> {
+				auto len = fread(ptr, 1, n, fin);
+				if (ferror(fin)) {
+					return std::unexpected{ErrorResponse{std::errc::io_error, "cannot read input stream"}};
+				}
+				return len;
+			}, progress, dst, amount);
+		}, 0);
+	}
+
+	std::optional<ErrorResponse> RawTextIngest::ingest(const path &filepath, ProgressTimer *progress) {
+		FileReader reader;
+		auto o = reader.openRaw(filepath);
+		if (!o.has_value())
+			return o.error();
+		return ingest(reader, o.value(), progress);
+	}
+
+	std::optional<ErrorResponse> RawTextIngest::ingest(FileReader &reader, std::uintmax_t filesize, ProgressTimer *progress) {
+		return ingest_stream([&reader, progress](uint8_t *dst, size_t amount) -> std::expected<size_t, ErrorResponse> {
+			return read_with_progress([&reader](uint8_t *ptr, size_t n) {
+				return reader.readContentBlock(reinterpret_cast<char *>(ptr), n);
+			}, progress, dst, amount);
+		}, filesize);
+	}
+
+	// ------------------------------------------------------------------------------------
+
+	namespace {
+
+		struct IngestedFileSlot {
+			// the amount charged against the in-flight budget for this one.
+			size_t charged_bytes;
+			IngestedFile file;
+		};
+
+		// the state shared by the workers and the delivering (calling) thread. Same scheme as the corpus loader: the
+		// workers grab the next file index off a shared atomic ticket counter and the in-flight budget keeps the
+		// amount of ingested-but-not-yet-delivered text in check.
+		//
+		// On top of that, delivered files return their buffers to a (small) pool, so the workers can ingest the next
+		// files without having to allocate (and fault in) fresh buffer memory every time.
+		struct IngestState {
+			const std::vector<path> &files;
+			const IngestedFileProcessor &process;
+			const RawTextIngestOptions &options;
+			size_t max_pool_size;
+			size_t max_pooled_capacity;
+
+			std::atomic<size_t> next_ticket{0};
+			std::atomic<bool> cancelled{false};
+
+			std::mutex mtx;
+			std::condition_variable budget_cv;			// workers wait here for in-flight budget
+			std::condition_variable delivery_cv;		// the delivering thread waits here for results
+
+			// --- protected by mtx: ---
+			size_t in_flight_bytes = 0;
+			size_t next_delivery = 0;					// the lowest index not yet delivered
+			std::map<size_t, IngestedFileSlot> ready;
+			std::vector<IngestedFile> pool;
+
+			IngestState(const std::vector<path> &files, const IngestedFileProcessor &process, const RawTextIngestOptions &options, size_t max_pool_size, size_t max_pooled_capacity) :
+				files(files), process(process), options(options), max_pool_size(max_pool_size), max_pooled_capacity(max_pooled_capacity) {
+			}
+
+			void worker(void);
+		};
+
+		void IngestState::worker(void) {
+			const size_t count = files.size();
+			RawTextIngest ingest(options.chunk_size);
+
+			for (;;) {
+				const size_t i = next_ticket.fetch_add(1, std::memory_order_relaxed);
+				if (i >= count || cancelled.load(std::memory_order_relaxed))
+					break;
+
+				const path &filepath = files[i];
+
+				// charge the buffer space the text is expected to take up front; the pooled buffer we MAY pick up
+				// can be larger than that, in which case we charge that one instead. Files which cannot be opened
+				// take no space at all.
+				FileReader reader;
+				auto o = reader.openRaw(filepath);
+				size_t charge = (o.has_value() ? RawTextIngest::expected_capacity(o.value()) : 0);
+
+				IngestedFile file;
+				{
+					std::unique_lock lk(mtx);
+					// the file next in line for delivery is always admitted: otherwise the budget may be fully taken by
+					// files which wait for it to be delivered first --> deadlock.
+					budget_cv.wait(lk, [&] {
+						return cancelled.load(std::memory_order_relaxed)
+							|| in_flight_bytes == 0
+							|| in_flight_bytes + charge <= options.max_in_flight_bytes
+							|| i == next_delivery;
+					});
+					if (cancelled.load(std::memory_order_relaxed))
+						break;
+
+					if (o.has_value() && !pool.empty()) {
+						file = std::move(pool.back());
+						pool.pop_back();
+						charge = std::max(charge, file.text.capacity());
+					}
+					in_flight_bytes += charge;
+				}
+
+				ingest.reuse(std::move(file.text));
+				file.lines.clear();
+				file.error = (o.has_value() ? ingest.ingest(reader, o.value()) : std::optional<ErrorResponse>{o.error()});
+				file.text = ingest.take_text();
+				if (!file.error && process)
+					process(i, filepath, file);
+
+				{
+					std::lock_guard lk(mtx);
+					// re-charge by the actual buffer space taken: UTF-16 MAY have made the text outgrow the file.
+					size_t actual = file.text.capacity();
+					in_flight_bytes = in_flight_bytes - charge + actual;
+					ready.emplace(i, IngestedFileSlot{actual, std::move(file)});
+				}
+				delivery_cv.notify_one();
+			}
+		}
+
+	}
+
+	std::expected<size_t, ErrorResponse> ingestFiles(const std::vector<path> &files, const IngestedFileProcessor &process, const IngestedFileCallback &deliver, const RawTextIngestOptions &options) {
+		const size_t count = files.size();
+		if (count == 0)
+			return 0;
+
+		unsigned thread_count = options.thread_count;
+		if (thread_count == 0)
+			thread_count = std::max(1U, std::thread::hardware_concurrency());
+		thread_count = unsigned(std::min<size_t>(thread_count, count));
+
+		// one spare buffer per worker; huge ones are not worth hanging on to.
+		IngestState state(files, process, options, thread_count, std::max<size_t>(options.max_in_flight_bytes / thread_count, options.chunk_size));
+
+		std::vector<std::jthread> workers;
+		workers.reserve(thread_count);
+		try {
+			for (unsigned t = 0; t < thread_count; t++) {
+				workers.emplace_back([&state] {
+					state.worker();
+				});
+			}
+		} catch (const std::system_error &e) {
+			if (workers.empty()) {
+				return std::unexpected{ErrorResponse{std::errc::resource_unavailable_try_again, std::format("cannot start the ingest worker threads: {}", e.what())}};
+			}
+			// else: make do with the threads we've got.
+		}
+
+		if (false) std::cout << "ingesting " << count << " files using " << workers.size() << " threads.\n";
+
+		size_t delivered = 0;
+		std::unique_lock lk(state.mtx);
+		while (delivered < count) {
+			state.delivery_cv.wait(lk, [&] {
+				return !state.ready.empty() && state.ready.begin()->first == state.next_delivery;
+			});
+			auto node = state.ready.extract(state.ready.begin());
+			lk.unlock();
+
+			const size_t index = node.key();
+			IngestedFile &file = node.mapped().file;
+			bool go_on = deliver(index, files[index], file);
+			delivered++;
+			const size_t released = node.mapped().charged_bytes;
+
+			lk.lock();
+			state.in_flight_bytes -= released;
+			state.next_delivery = index + 1;
+			if (state.pool.size() < state.max_pool_size && file.text.capacity() > 0 && file.text.capacity() <= state.max_pooled_capacity) {
+				state.pool.push_back(std::move(file));
+			}
+			state.budget_cv.notify_all();
+
+			if (!go_on) {
+				state.cancelled = true;
+				break;
+			}
+		}
+		lk.unlock();
+		state.budget_cv.notify_all();
+
+		// the jthreads join on destruction.
+		workers.clear();
+
+		return delivered;
+	}
+
+}
@@ -0,0 +1,172 @@
+//
+// Ingest arbitrary (binary) data as text: the raw-data-to-text cleanup stage shared by the codestripper and
+// strings3 tools.
+//
+// Everything that isn't printable ASCII, TAB, LF or well-formed UTF-8 is rewritten on the fly: CR, other control
+// characters, DEL and undecodable bytes become LF, and UTF-16 (LE/BE, with or without BOM) runs are transcoded to UTF-8.
+//
+
+#pragma once
+
+#include "Base.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <optional>
+#include <vector>
+
+
+namespace text_processing {
+
+	using std::filesystem::path;
+
+	struct FileReader;
+
+	// run an async timer task which sets a mark every time a bit of progress MAY be shown.
+	// This takes care of the variable and sometimes obnoxiously high '.' dot progress rate/output.
+	class ProgressTimer {
+		std::future<int> t;
+		std::atomic<bool> ticked = false;
+		std::atomic<bool> must_stop = false;
+
+	public:
+		void init(void);
+
+		~ProgressTimer();
+
+		int timer_task(void);
+
+		void show_progress(void);
+
+		bool tick(void) const {
+			return ticked;
+		}
+	};
+
+	// the number of NUL bytes `cleanRawDataIntoText()` expects to follow the raw data, so it can look ahead without
+	// checking the end of the data every time. `TextBuffer`'s sentinel is more than enough.
+	static constexpr const size_t raw_data_tail_size = 8;
+	static_assert(TextBuffer::sentinel_size >= raw_data_tail_size);
+
+	struct RawTextCleanupResult {
+		size_t consumed;		// raw data bytes
+		size_t written;			// text bytes
+	};
+
+	// what carries over from one chunk of raw data to the next.
+	struct RawTextCleanupState {
+		// a UTF-16 run lasted until the end of the chunk: the next chunk continues it.
+		bool utf16_run_active = false;
+		bool utf16_big_endian = false;
+	};
+
+	// rewrite the raw data [src, src+srcsize) in place as text.
+	//
+	// The raw data MUST be followed by `raw_data_tail_size` NUL bytes.
+	//
+	// The text takes no more space than the raw data, except for UTF-16 which transcodes to 3-byte UTF-8 (CJK and the
+	// like): once that text catches up with the raw data, the remainder of the UTF-16 run is transcoded into
+	// `overflow` and we stop right after that run. The text then continues with `overflow`: call again for the raw
+	// data following `consumed`. Otherwise `overflow` is left empty.
+	//
+	// When `forced_process_all` is false, more raw data is expected to follow: the last few bytes, which MAY be the
+	// start of a multibyte sequence continued in the next chunk, are then left alone: `consumed` reports how far we
+	// got. A UTF-16 run which lasts until the end of the raw data is noted in `state`, so the next call, for the next
+	// chunk, continues transcoding right away. Otherwise all of the raw data is consumed.
+	RawTextCleanupResult cleanRawDataIntoText(uint8_t *src, size_t srcsize, bool forced_process_all, std::vector<uint8_t> &overflow, RawTextCleanupState &state);
+
+	// the streaming stage: read raw data from any number of sources in chunks, clean it up and collect the text in
+	// a single `TextBuffer`, which grows as needed. Unconsumed chunk tails are carried over into the next read,
+	// so multibyte sequences which straddle a chunk boundary survive intact.
+	class RawTextIngest {
+	public:
+		static constexpr const size_t default_chunk_size = 16 * 1024 * 1024;
+
+		explicit RawTextIngest(size_t chunk_size = default_chunk_size);
+
+		// read `fin` (stdin, a pipe, ...) until EOF.
+		std::optional<ErrorResponse> ingest(FILE *fin, ProgressTimer *progress = nullptr);
+
+		// read the file at `filepath`; the text buffer is grown once to fit the whole file, if need be.
+		std::optional<ErrorResponse> ingest(const path &filepath, ProgressTimer *progress = nullptr);
+
+		// read the file `reader` has just opened (`FileReader::openRaw()`), which is `filesize` bytes.
+		std::optional<ErrorResponse> ingest(FileReader &reader, std::uintmax_t filesize, ProgressTimer *progress = nullptr);
+
+		// the buffer space a `filesize` bytes file takes: the text is no larger than the raw data, unless it
+		// carries UTF-16 which transcodes to 3-byte UTF-8.
+		static constexpr size_t expected_capacity(std::uintmax_t filesize) {
+			return size_t(filesize) + raw_data_tail_size + TextBuffer::sentinel_size;
+		}
+
+		// the text collected so far, NUL sentinel included.
+		const TextBuffer &text() const {
+			return _text;
+		}
+
+		// hand over the collected text; the stage starts afresh.
+		TextBuffer take_text();
+
+		// start afresh, collecting the text in `buffer`: a buffer which has served before, so we MAY not have to
+		// allocate anything at all.
+		void reuse(TextBuffer &&buffer);
+
+	protected:
+		// the read-clean-carry loop for both `ingest()` flavors: `read` fills up to `amount` bytes at `dst` and
+		// returns the number of bytes read; 0 at EOF.
+		template <class Reader>
+		std::optional<ErrorResponse> ingest_stream(Reader &&read, size_t size_hint);
+
+		std::optional<ErrorResponse> make_room(size_t amount);
+
+		size_t _chunk_size;
+		TextBuffer _text;
+		size_t _text_length = 0;	// the cleaned up text at the start of `_text`
+		size_t _pending = 0;		// raw data bytes following the text, waiting for the next chunk
+		std::vector<uint8_t> _overflow;		// see `cleanRawDataIntoText()`
+		RawTextCleanupState _cleanup_state;
+	};
+
+
+	// ------------------------------------------------------------------------------------
+
+	// ingest a list of files concurrently, using a pool of worker threads, delivering the results in input order.
+
+	struct RawTextIngestOptions {
+		// number of worker threads; 0: one per hardware thread.
+		unsigned thread_count = 0;
+
+		// upper bound for the buffer space (in bytes) held by ingested files which have not been delivered yet.
+		//
+		// A single file larger than this is still ingested: it just has to wait until it has the budget all to itself.
+		size_t max_in_flight_bytes = 256 * 1024 * 1024;
+
+		size_t chunk_size = RawTextIngest::default_chunk_size;
+	};
+
+	struct IngestedFile {
+		std::optional<ErrorResponse> error;
+		TextBuffer text;
+		// for the `IngestedFileProcessor` to fill, e.g. with views into `text`.
+		std::vector<std::string_view> lines;
+	};
+
+	// called on the worker thread which ingested the file at `filepath`, for every file which was ingested
+	// successfully: the place to do the (expensive) per-file processing in parallel.
+	using IngestedFileProcessor = std::function<void(size_t index, const path &filepath, IngestedFile &file)>;
+
+	// called on the *calling* thread, in input order; `index` is the index of `filepath` in the input list.
+	// Once this returns, the `file` buffers are recycled for the next files, unless you moved them out.
+	//
+	// Return `false` to abort.
+	using IngestedFileCallback = std::function<bool(size_t index, const path &filepath, IngestedFile &file)>;
+
+	// Returns the number of files delivered to the callback.
+	//
+	// Errors ingesting individual files are delivered to the callback, like any other result; this only fails when
+	// it cannot start any worker thread.
+	std::expected<size_t, ErrorResponse> ingestFiles(const std::vector<path> &files, const IngestedFileProcessor &process, const IngestedFileCallback &deliver, const RawTextIngestOptions &options = {});
+
+}
@@ -3,6 +3,11 @@
 
 #include "PrivateUtilities.hpp"
 
+#include <bit>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #if defined(_WIN32)
 #ifndef _CRT_DECLARE_NONSTDC_NAMES
 #define _CRT_DECLARE_NONSTDC_NAMES  1
@@ -10,6 +15,11 @@
 #include <io.h>
 #include <fcntl.h>
 #include <string.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
 #endif
 
 
@@ -27,6 +37,21 @@ namespace text_processing {
 			fclose(handle);
 			handle = nullptr;
 		}
+#if !defined(_WIN32)
+		if (fd >= 0) {
+			::close(fd);
+			fd = -1;
+		}
+		direct_io = false;
+#endif
+	}
+
+	int FileReader::descriptor(void) const {
+#if !defined(_WIN32)
+		if (fd >= 0)
+			return fd;
+#endif
+		return (handle != nullptr ? fileno(handle) : -1);
 	}
 
 	std::optional<ErrorResponse> FileReader::open(const path &filepath) {
@@ -39,6 +64,38 @@ namespace text_processing {
 		return std::nullopt;
 	}
 
+	std::expected<std::uintmax_t, ErrorResponse> FileReader::openRaw(const path &filepath) {
+#if defined(_WIN32)
+		auto o = open(filepath);
+		if (o)
+			return std::unexpected{o.value()};
+		std::error_code ec;
+		const std::uintmax_t filesize = fs::file_size(filepath, ec);
+		if (ec) {
+			return std::unexpected{ErrorResponse{std::errc::io_error, std::format("file size for file \"{}\" cannot be determined; {}", filespec, ec.message())}};
+		}
+		return filesize;
+#else
+		filespec = reinterpret_cast<const char *>(filepath.generic_u8string().c_str());
+		fd = ::open(filespec.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			auto e = errno;
+			return std::unexpected{ErrorResponse{std::errc::io_error, std::format("cannot open file \"{}\": error {}:{}", filespec, e, strerror(e))}};
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			auto e = errno;
+			close();
+			return std::unexpected{ErrorResponse{std::errc::io_error, std::format("file size for file \"{}\" cannot be determined; error {}:{}", filespec, e, strerror(e))}};
+		}
+#if defined(POSIX_FADV_SEQUENTIAL)
+		// a hint only: bigger read-ahead. Failure is harmless.
+		(void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+		return std::uintmax_t(st.st_size);
+#endif
+	}
+
 	bool FileReader::reserve_bufferspace(size_t amount) {
 		amount += TextBuffer::sentinel_size;  // plenty space for sentinels
 		if (data.capacity() < amount) {
@@ -73,6 +130,214 @@ namespace text_processing {
 		return rv;
 	}
 
+	std::expected<size_t, ErrorResponse> FileReader::readAllContentUntilEOF(size_t expected_size) {
+		if (data.capacity() == 0) {
+			if (!reserve_bufferspace(expected_size)) {
+				return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("out of memory while processing file \"{}\".", filespec)}};
+			}
+		}
+		assert(data.data() != nullptr);
+
+		return readRemainingContentUntilEOF(0);
+	}
+
+	std::expected<size_t, ErrorResponse> FileReader::readRemainingContentUntilEOF(size_t total) {
+		for (;;) {
+			// the room for content: all of the buffer but the sentinel. Once that's filled, we peek into the sentinel
+			// space to see whether we're at EOF, before we go and grow the buffer.
+			const size_t room = data.capacity() - TextBuffer::sentinel_size;
+			const size_t amount = (total < room ? room - total : TextBuffer::sentinel_size);
+			auto r = readContentBlock(data.data() + total, amount);
+			if (!r.has_value())
+				return r;
+			if (r.value() == 0)
+				break;
+			total += r.value();
+			if (total > room) {
+				// the file has grown since we opened it.
+				std::error_code ec;
+				if (data.grow(total + std::max<size_t>(total / 2, 64 * 1024), ec), ec) {
+					return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("out of memory while processing file \"{}\".", filespec)}};
+				}
+			}
+		}
+		// write string sentinel:
+		data.data()[total] = 0;
+
+		// mark the buffer space used (excluding the sentinel) as occupied/content.
+		data.set_content_size(total);
+
+		return total;
+	}
+
+	std::expected<std::uintmax_t, ErrorResponse> FileReader::openDirect(const path &filepath) {
+#if defined(O_DIRECT)
+		filespec = reinterpret_cast<const char *>(filepath.generic_u8string().c_str());
+		fd = ::open(filespec.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+		if (fd >= 0) {
+			struct stat st;
+			if (fstat(fd, &st) != 0) {
+				auto e = errno;
+				close();
+				return std::unexpected{ErrorResponse{std::errc::io_error, std::format("file size for file \"{}\" cannot be determined; error {}:{}", filespec, e, strerror(e))}};
+			}
+			direct_io = true;
+			return std::uintmax_t(st.st_size);
+		}
+		// EINVAL: the filesystem doesn't do O_DIRECT. Any other error is reported by `openRaw()` just the same.
+#endif
+		// buffered it is.
+		auto rv = openRaw(filepath);
+#if defined(__APPLE__)
+		// the macOS way of keeping the content out of the page cache.
+		if (rv.has_value())
+			(void)fcntl(fd, F_NOCACHE, 1);
+#endif
+		return rv;
+	}
+
+	std::expected<size_t, ErrorResponse> FileReader::readAllContentDirect(size_t expected_size) {
+#if !defined(O_DIRECT)
+		return readAllContentUntilEOF(expected_size);
+#else
+		if (!direct_io) {
+			auto rv = readAllContentUntilEOF(expected_size);
+#if defined(POSIX_FADV_DONTNEED)
+			// buffered fallback: at least drop the (clean) pages we just pulled into the page cache again, so a one-shot
+			// scan doesn't push everybody else's working set out of memory.
+			if (rv.has_value() && fd >= 0)
+				(void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+			return rv;
+		}
+
+		std::error_code ec;
+		if (data.capacity() == 0) {
+			if (data.reserve_aligned(expected_size, direct_io_alignment, ec), ec) {
+				return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("out of memory while processing file \"{}\".", filespec)}};
+			}
+		}
+		assert(data.storage_kind() == TextBuffer::StorageKind::Aligned);
+		assert((reinterpret_cast<uintptr_t>(data.data()) & (direct_io_alignment - 1)) == 0);
+
+		size_t total = 0;
+		for (;;) {
+			// O_DIRECT transfers whole blocks: buffer address, file offset and transfer size must all be block aligned.
+			// Hence we read into the entire (aligned) capacity, sentinel space included; only the last block, at EOF,
+			// comes back short. A short read anywhere else leaves us unaligned and the next read fails with EINVAL.
+			const size_t room = data.capacity() & ~(direct_io_alignment - 1);
+			if (total == room) {
+				// the file has grown since we opened it.
+				if (data.grow(total + std::max<size_t>(total / 2, 64 * 1024), ec), ec) {
+					return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("out of memory while processing file \"{}\".", filespec)}};
+				}
+				continue;
+			}
+			const ssize_t n = ::read(fd, data.data() + total, std::min<size_t>(room - total, max_direct_io_transfer));
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EINVAL) {
+					// the filesystem accepted O_DIRECT at open time but refuses the transfer (stricter alignment
+					// requirements than ours, an unaligned offset after a short read, ...): read the remainder buffered.
+					const int flags = fcntl(fd, F_GETFL);
+					if (flags != -1 && fcntl(fd, F_SETFL, flags & ~O_DIRECT) == 0) {
+						direct_io = false;
+						break;
+					}
+				}
+				auto e = errno;
+				return std::unexpected{ErrorResponse{std::errc::io_error, std::format("cannot read file content of file \"{}\": error {}:{}", filespec, e, strerror(e))}};
+			}
+			if (n == 0) {
+				// make sure the sentinel fits.
+				if (data.capacity() < total + TextBuffer::sentinel_size) {
+					if (data.grow(total, ec), ec) {
+						return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("out of memory while processing file \"{}\".", filespec)}};
+					}
+				}
+				// write string sentinel:
+				data.data()[total] = 0;
+
+				// mark the buffer space used (excluding the sentinel) as occupied/content.
+				data.set_content_size(total);
+
+				return total;
+			}
+			total += size_t(n);
+		}
+
+		// the buffered remainder:
+		if (data.capacity() < total + TextBuffer::sentinel_size) {
+			if (data.grow(total, ec), ec) {
+				return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("out of memory while processing file \"{}\".", filespec)}};
+			}
+		}
+		return readRemainingContentUntilEOF(total);
+#endif
+	}
+
+	std::expected<size_t, ErrorResponse> FileReader::readContentChunk(size_t offset, size_t amount) {
+		assert(data.capacity() >= offset + amount + TextBuffer::sentinel_size);
+		assert(data.data() != nullptr);
+
+		auto r = readContentBlock(data.data() + offset, amount);
+		if (!r.has_value())
+			return r;
+		const size_t rv = r.value();
+		// write string sentinel:
+		data.data()[offset + rv] = 0;
+
+		data.set_content_size(offset + rv);
+
+		return rv;
+	}
+
+	std::expected<size_t, ErrorResponse> FileReader::readContentBlock(char *dst, size_t amount) {
+#if !defined(_WIN32)
+		if (fd >= 0) {
+			// as `fread()`: keep reading until we have it all or hit EOF.
+			size_t total = 0;
+			while (total < amount) {
+				const ssize_t n = ::read(fd, dst + total, amount - total);
+				if (n < 0) {
+					if (errno == EINTR)
+						continue;
+					auto e = errno;
+					return std::unexpected{ErrorResponse{std::errc::io_error, std::format("cannot read file content of file \"{}\": error {}:{}", filespec, e, strerror(e))}};
+				}
+				if (n == 0)
+					break;
+				total += size_t(n);
+			}
+			return total;
+		}
+#endif
+		auto rv = fread(dst, 1, amount, handle);
+		if (ferror(handle)) {
+			auto e = errno;
+			return std::unexpected{ErrorResponse{std::errc::io_error, std::format("cannot read file content of file \"{}\": error {}:{}", filespec, e, strerror(e))}};
+		}
+		return rv;
+	}
+
+	std::expected<size_t, ErrorResponse> FileReader::mapAllContent(size_t amount, size_t requested_buffer_size) {
+		std::error_code ec;
+#if defined(_WIN32)
+		// not supported (yet): fall back to the classic read.
+		if (data.reserve(requested_buffer_size, ec), ec) {
+			return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("out of memory while processing file \"{}\".", filespec)}};
+		}
+		return readAllContent(amount);
+#else
+		data.map_file(descriptor(), amount, requested_buffer_size, ec);
+		if (ec) {
+			return std::unexpected{ErrorResponse{std::errc::io_error, std::format("cannot memory map file \"{}\": error {}:{}", filespec, ec.value(), ec.message())}};
+		}
+		return amount;
+#endif
+	}
+
 	// ------------------------------------------------------------------------------------
 
 	FileContent::FileContent(const TextBuffer &s) :
@@ -93,31 +358,28 @@ namespace text_processing {
 	}
 
 
-	FileContentParseResult processFile(const path& filepath, const searchPaths& search_paths) {
-		return locateFile(filepath, filepath, search_paths).and_then([](path &&p) -> FileContentParseResult {
+	FileContentParseResult processFile(const path& filepath, const searchPaths& search_paths, FileContentProcessingOptions::LoadMode load_mode) {
+		return locateFile(filepath, filepath, search_paths).and_then([load_mode](path &&p) -> FileContentParseResult {
 			// https://medium.com/@nerudaj/tuesday-coding-tip-78-many-ways-of-reading-a-file-in-c-e66191dc60e3
 
-			std::error_code ec;
-			if (const std::uintmax_t filesize = fs::file_size(p, ec); ec) {
-				if (false) std::cout << p.generic_string() << " : " << ec.message() << '\n';
-				return std::unexpected{ErrorResponse{std::errc::io_error, std::format("file size for file \"{}\" cannot be determined; {}", p.generic_string(), ec.message())}};
-			} else {
-				if (false) std::cout << p.generic_string() << " size = " << HumanReadable{filesize} << '\n';
+			// the file size is taken from the open handle: no second path resolution and no size/content race.
+			FileReader reader;
+			auto o = (load_mode == FileContentProcessingOptions::DirectIO ? reader.openDirect(p) : reader.openRaw(p));
+			if (!o.has_value())
+				return std::unexpected{o.error()};
+			const std::uintmax_t filesize = o.value();
 
-				FileReader reader;
-				auto o = reader.open(p);
-				if (o)
-					return std::unexpected{o.value()};
-				auto r = reader.readAllContent(filesize);
-				if (!r.has_value())
-					return std::unexpected{r.error()};
-				reader.close();
+			if (false) std::cout << p.generic_string() << " size = " << HumanReadable{filesize} << '\n';
 
-				FileContent rv(reader.data);
-				return rv;
-			}
+			auto r = (load_mode == FileContentProcessingOptions::MemoryMapped ? reader.mapAllContent(filesize, filesize + TextBuffer::sentinel_size) :
+					  load_mode == FileContentProcessingOptions::DirectIO ? reader.readAllContentDirect(filesize) :
+					  reader.readAllContentUntilEOF(filesize));
+			if (!r.has_value())
+				return std::unexpected{r.error()};
+			reader.close();
 
-			return std::unexpected{ErrorResponse{std::errc::no_such_file_or_directory, std::format("file \"{}\" does not exist.", p.generic_string())}};
+			FileContent rv(std::move(reader.data));
+			return rv;
 		});
 	}
 
@@ -152,63 +414,476 @@ namespace text_processing {
 	}
 
 
+	static constexpr const size_t default_chunk_size = 4 * 1024 * 1024;
+
+	static inline bool is_chunk_eol(const char c) {
+		return c == '\n' || c == '\r' || c == '\f' || c == 0;
+	}
+
+	static inline bool is_chunk_blank(const char c) {
+		return c == ' ' || c == '\t' || c == '\v';
+	}
+
+	// returns the end of the last complete line in the buffer, or 0 when there's none.
+	static size_t find_last_line_break(const char *ptr, size_t len) {
+		while (len > 0) {
+			if (is_chunk_eol(ptr[len - 1]))
+				return len;
+			len--;
+		}
+		return 0;
+	}
+
+	// returns the end of the last complete paragraph in the buffer, i.e. the position right after the last line
+	// terminator in the last whitespace run which contains an empty line (or a form feed), or 0 when there's none.
+	//
+	// NOT the end of that whitespace run: any whitespace following the last line terminator is the leading indent of
+	// the next paragraph, which must go with that one.
+	static size_t find_last_paragraph_break(const char *ptr, size_t len) {
+		size_t i = len;
+		while (i > 0) {
+			// walk back to the end of the previous whitespace run:
+			while (i > 0 && !is_chunk_eol(ptr[i - 1]) && !is_chunk_blank(ptr[i - 1])) {
+				i--;
+			}
+			// the end of the last line terminator in the run:
+			size_t cut = 0;
+			// count the line ends in the run: CRLF, LF-only and CR-only files all must be served.
+			size_t lf_count = 0;
+			size_t cr_count = 0;
+			while (i > 0 && (is_chunk_eol(ptr[i - 1]) || is_chunk_blank(ptr[i - 1]))) {
+				if (cut == 0 && is_chunk_eol(ptr[i - 1]))
+					cut = i;
+				switch (ptr[i - 1]) {
+				case '\n':
+					lf_count++;
+					break;
+				case '\r':
+					cr_count++;
+					break;
+				case '\f':
+				case 0:
+					lf_count += 2;
+					break;
+				}
+				i--;
+			}
+			if (lf_count >= 2 || (lf_count == 0 && cr_count >= 2))
+				return cut;
+		}
+		return 0;
+	}
+
+	// the pipelined load mode:
+	//
+	// a reader thread fills the (fully reserved) buffer block by block, while the calling thread splits the lines and
+	// words off the blocks read so far, up to the last line end therein. Hence reading and splitting overlap and the
+	// total time approaches max(read, split) instead of their sum. As the whole file ends up in a single buffer
+	// anyway, there's no need for double/triple buffering: the reader simply never stops to wait for the splitter.
+	//
+	// The splitter always stays `TextBuffer::sentinel_size` bytes behind the reader: the SIMD scanners look up to
+	// 31 bytes beyond the end of the range they're given and must not touch the bytes still being read.
+	//
+	// Everything else (paragraphs, n-grams) is produced once the entire content is in.
+	static constexpr const size_t pipeline_block_size = 1024 * 1024;
+
+	static std::optional<ErrorResponse> read_and_split_pipelined(FileReader &reader, ExtendedFileContent &rv, size_t filesize, const FileContentProcessingOptions& options, std::error_code &ec) {
+		using mode = FileContentProcessingOptions::ParseMode;
+
+		const bool want_lines = (options.mode & mode::ToTextLines);
+		const bool want_words = (options.mode & (mode::ToWords | mode::ToNGrams));
+
+		char *base = rv.file_content.data();
+
+		std::mutex mtx;
+		std::condition_variable progress_cv;
+		// --- protected by mtx: ---
+		size_t ready = 0;
+		bool done = false;
+		bool out_of_room = false;
+		std::optional<ErrorResponse> read_error;
+
+		// read until EOF, like the other load modes do: the file MAY have grown since we took its size. That's read
+		// into the scratch space beyond the content, as far as it goes; we cannot grow the buffer underneath the
+		// splitter, so anything beyond that is left for later.
+		const size_t room = rv.file_content.capacity() - TextBuffer::sentinel_size;
+		std::jthread reader_thread([&](std::stop_token stop) {
+			size_t offset = 0;
+			while (!stop.stop_requested()) {
+				if (offset >= room) {
+					std::lock_guard lk(mtx);
+					out_of_room = true;
+					break;
+				}
+				auto r = reader.readContentBlock(base + offset, std::min(pipeline_block_size, room - offset));
+				if (!r.has_value()) {
+					std::lock_guard lk(mtx);
+					read_error = r.error();
+					break;
+				}
+				if (r.value() == 0)
+					break;
+				offset += r.value();
+				{
+					std::lock_guard lk(mtx);
+					ready = offset;
+				}
+				progress_cv.notify_one();
+			}
+			{
+				std::lock_guard lk(mtx);
+				done = true;
+			}
+			progress_cv.notify_one();
+		});
+
+		// apply heuristics: ~10 bytes per line, ~6 bytes per word.
+		if (want_lines) {
+			if (options.compact_spans)
+				rv.compact_lines.reserve(filesize / 10);
+			else
+				rv.lines.reserve(filesize / 10);
+		}
+		if (want_words) {
+			if (options.compact_spans)
+				rv.compact_words.reserve(filesize / 6);
+			else
+				rv.words.reserve(filesize / 6);
+		}
+
+		auto split_range = [&](size_t start, size_t end) {
+			if (want_lines) {
+				if (rv.parseContentRangeAsLines(start, end, options, ec), ec)
+					return;
+			}
+			if (want_words) {
+				rv.parseContentRangeAsWords(start, end, options, ec);
+			}
+		};
+
+		size_t processed = 0;
+		size_t wanted = TextBuffer::sentinel_size + 1;
+		for (;;) {
+			size_t available;
+			{
+				std::unique_lock lk(mtx);
+				progress_cv.wait(lk, [&] {
+					return done || ready >= wanted;
+				});
+				if (done)
+					break;
+				available = ready;
+			}
+
+			const size_t limit = available - TextBuffer::sentinel_size;
+			const size_t end = processed + find_last_line_break(base + processed, limit - processed);
+			if (end > processed) {
+				if (split_range(processed, end), ec) {
+					reader_thread.request_stop();
+					break;
+				}
+				processed = end;
+			}
+			// wait for (at least) the next block.
+			wanted = available + 1;
+		}
+		reader_thread.join();
+
+		if (read_error)
+			return read_error;
+		if (ec)
+			return std::nullopt;
+
+		if (ready > filesize) {
+			// the file has grown since we opened it: read the remainder, if any, and make room for the scratch space
+			// the rewriting passes need. That MAY move the buffer, so we split the content all over again.
+			reader.data = std::move(rv.file_content);
+			if (out_of_room) {
+				auto r = reader.readRemainingContentUntilEOF(ready);
+				if (!r.has_value())
+					return r.error();
+				ready = r.value();
+			}
+			const size_t size_request = estimateRequiredLumpSumBufferSpace(ready, options);
+			if (reader.data.grow(size_request, ec), ec) {
+				return ErrorResponse{std::errc::not_enough_memory, std::format("failure while preparing buffer space ({}) for file \"{}\": error {}:{}", HumanReadable(size_request).to_string(), reader.filespec, ec.value(), ec.message())};
+			}
+			rv.file_content = std::move(reader.data);
+			rv.lines.clear();
+			rv.compact_lines.clear();
+			rv.words.clear();
+			rv.compact_words.clear();
+			processed = 0;
+		}
+
+		rv.file_content.set_content_size(ready);
+		rv.file_content.ensure_text_edge_sentinel();
+		split_range(processed, ready);
+		return std::nullopt;
+	}
+
+	// reject option values we cannot honor, before we go and load any file content.
+	static std::optional<ErrorResponse> check_processing_options(const FileContentProcessingOptions& options) {
+		if ((options.mode & FileContentProcessingOptions::ToNGrams) && options.ngram_size > NGramDictionary::max_ngram_size) {
+			return ErrorResponse{std::errc::invalid_argument, std::format("n-gram size {} is out of range: at most {} words per n-gram are supported.", unsigned(options.ngram_size), NGramDictionary::max_ngram_size)};
+		}
+		if (options.load_mode == FileContentProcessingOptions::Pipelined && (options.exact_reservation || options.split_thread_count != 1)) {
+			return ErrorResponse{std::errc::invalid_argument, "the pipelined load mode splits the content block by block, while it is being read: it cannot count the lines up front (exact_reservation) nor split the content using multiple threads (split_thread_count)."};
+		}
+		return std::nullopt;
+	}
+
 	ExtendedFileContentParseResult processFileEx(const path& filepath, const searchPaths& search_paths, const FileContentProcessingOptions& options) {
+		if (auto e = check_processing_options(options))
+			return std::unexpected{e.value()};
+
 		return locateFile(filepath, filepath, search_paths).and_then([options](path &&p) -> ExtendedFileContentParseResult {
 			// https://medium.com/@nerudaj/tuesday-coding-tip-78-many-ways-of-reading-a-file-in-c-e66191dc60e3
 
+			// the file size is taken from the open handle: no second path resolution and no size/content race.
+			FileReader reader;
+			auto o = (options.load_mode == FileContentProcessingOptions::DirectIO ? reader.openDirect(p) : reader.openRaw(p));
+			if (!o.has_value())
+				return std::unexpected{o.error()};
+			const std::uintmax_t filesize = o.value();
+
+			if (false) std::cout << p.generic_string() << " size = " << HumanReadable{filesize} << '\n';
+
 			std::error_code ec;
-			if (const std::uintmax_t filesize = fs::file_size(p, ec); ec) {
-				if (false) std::cout << p.generic_string() << " : " << ec.message() << '\n';
-				return std::unexpected{ErrorResponse{std::errc::io_error, std::format("file size for file \"{}\" cannot be determined; {}", p.generic_string(), ec.message())}};
-			}
-			else {
-				if (false) std::cout << p.generic_string() << " size = " << HumanReadable{filesize} << '\n';
 
-				FileReader reader;
-				auto o = reader.open(p);
-				if (o)
-					return std::unexpected{o.value()};
+			size_t size_request = estimateRequiredLumpSumBufferSpace(filesize, options);
+			if (options.load_mode == FileContentProcessingOptions::Pipelined) {
+				if (options.arena) {
+					reader.data.reserve(size_request, *options.arena, ec);
+				} else {
+					reader.data.reserve(size_request, ec);
+				}
+				if (ec) {
+					return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("failure while preparing buffer space ({}) for file \"{}\": error {}:{}", HumanReadable(size_request).to_string(), p.generic_string(), ec.value(), ec.message())}};
+				}
+
+				ExtendedFileContent rv(std::move(reader.data));
+
+				using mode = FileContentProcessingOptions::ParseMode;
+
+				auto e = read_and_split_pipelined(reader, rv, filesize, options, ec);
+				if (e)
+					return std::unexpected{e.value()};
+				if (ec) {
+					return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\": error {}:{}", p.generic_string(), ec.value(), ec.message())}};
+				}
+				reader.close();
+
+				if (options.mode & mode::ToParagraphs) {
+					if (rv.parseContentAsParagraphs(options, ec), ec) {
+						return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\" into text paragraphs: error {}:{}", p.generic_string(), ec.value(), ec.message())}};
+					}
+				}
+				if (options.mode & mode::ToNGrams) {
+					// picks up the words we already have.
+					if (rv.parseContentAsNGrams(options, ec), ec) {
+						return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\" into ngrams: error {}:{}", p.generic_string(), ec.value(), ec.message())}};
+					}
+				}
+				return rv;
+			}
 
-				size_t size_request = estimateRequiredLumpSumBufferSpace(filesize, options);
-				if (reader.data.reserve(size_request, ec), ec) {
+			if (options.load_mode == FileContentProcessingOptions::MemoryMapped) {
+				// the scratch space for the rewriting passes is mapped right behind the file content.
+				auto r = reader.mapAllContent(filesize, size_request);
+				if (!r.has_value())
+					return std::unexpected{r.error()};
+			} else {
+				const bool direct = (options.load_mode == FileContentProcessingOptions::DirectIO);
+				if (direct) {
+					// the block transfers land straight in the buffer, hence the alignment. No arena for this one.
+					reader.data.reserve_aligned(size_request, FileReader::direct_io_alignment, ec);
+				} else if (options.arena) {
+					reader.data.reserve(size_request, *options.arena, ec);
+				} else {
+					reader.data.reserve(size_request, ec);
+				}
+				if (ec) {
 					return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("failure while preparing buffer space ({}) for file \"{}\": error {}:{}", HumanReadable(size_request).to_string(), p.generic_string(), ec.value(), ec.message())}};
 				}
 
-				auto r = reader.readAllContent(filesize);
+				auto r = (direct ? reader.readAllContentDirect(filesize) : reader.readAllContentUntilEOF(filesize));
 				if (!r.has_value())
 					return std::unexpected{r.error()};
-				reader.close();
+				if (r.value() > filesize) {
+					// the file grew while we were reading it: the rewriting passes need their scratch space nevertheless.
+					size_request = estimateRequiredLumpSumBufferSpace(r.value(), options);
+					if (reader.data.grow(size_request, ec), ec) {
+						return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("failure while preparing buffer space ({}) for file \"{}\": error {}:{}", HumanReadable(size_request).to_string(), p.generic_string(), ec.value(), ec.message())}};
+					}
+				}
+			}
+			reader.close();
 
-				ExtendedFileContent rv(reader.data);
+			ExtendedFileContent rv(std::move(reader.data));
 
-				using mode = FileContentProcessingOptions::ParseMode;
+			using mode = FileContentProcessingOptions::ParseMode;
+
+			if (std::popcount(unsigned(options.mode & (mode::ToTextLines | mode::ToParagraphs | mode::ToWords | mode::ToNGrams))) > 1) {
+				// multiple modes: do them all in a single pass over the content.
+				if (rv.parseContent(options, ec), ec) {
+					return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\": error {}:{}", p.generic_string(), ec.value(), ec.message())}};
+				}
+				return rv;
+			}
+
+			if (options.mode & mode::ToTextLines) {
+				if (rv.parseContentAsLines(options, ec), ec) {
+					return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\" into text lines: error {}:{}", p.generic_string(), ec.value(), ec.message())}};
+				}
+			}
+			if (options.mode & mode::ToParagraphs) {
+				if (rv.parseContentAsParagraphs(options, ec), ec) {
+					return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\" into text paragraphs: error {}:{}", p.generic_string(), ec.value(), ec.message())}};
+				}
+			}
+			if (options.mode & mode::ToWords) {
+				if (rv.parseContentAsWords(options, ec), ec) {
+					return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\" into words: error {}:{}", p.generic_string(), ec.value(), ec.message())}};
+				}
+			}
+			if (options.mode & mode::ToNGrams) {
+				if (rv.parseContentAsNGrams(options, ec), ec) {
+					return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\" into ngrams: error {}:{}", p.generic_string(), ec.value(), ec.message())}};
+				}
+			}
+			return rv;
+		});
+	}
+
+	// ------------------------------------------------------------------------------------
+
+	std::expected<std::uintmax_t, ErrorResponse> processFileInChunks(const path& filepath, const FileContentChunkCallback &callback, const searchPaths& search_paths, const FileContentProcessingOptions& chunk_options, size_t chunk_size) {
+		// the n-gram stitching across chunk boundaries works on `words`: no compact spans for the chunks.
+		FileContentProcessingOptions options = chunk_options;
+		options.compact_spans = false;
+		if (auto e = check_processing_options(options))
+			return std::unexpected{e.value()};
+
+		return locateFile(filepath, filepath, search_paths).and_then([&](path &&p) -> std::expected<std::uintmax_t, ErrorResponse> {
+			FileReader reader;
+			auto o = reader.openRaw(p);
+			if (!o.has_value())
+				return std::unexpected{o.error()};
+
+			using mode = FileContentProcessingOptions::ParseMode;
+
+			const bool want_paragraphs = (options.mode & mode::ToParagraphs);
+			const bool want_ngrams = (options.mode & mode::ToNGrams);
+			const size_t ngram_overlap = std::max<unsigned>(options.ngram_size, 1) - 1;
+
+			size_t window_size = std::max<size_t>(chunk_size ? chunk_size : default_chunk_size, 64);
+
+			// the chunk being processed; the line/word/... lists are reused, so they stop reallocating after the first few rounds.
+			ExtendedFileContent work;
+			// the incomplete line/paragraph at the end of the previous window
+			std::string carry;
+			// the last few words of the previous chunk: the n-grams straddling the chunk boundary need them.
+			std::string tail_text;
+			ExtendedFileContent::list tail_words;
+
+			std::uintmax_t offset = 0;
+			std::error_code ec;
+			bool eof = false;
+
+			while (!eof) {
+				// (re)allocate the window when it has no room left for a decent read after the carry-over.
+				if (work.file_content.capacity() == 0 || carry.size() > window_size / 2) {
+					while (carry.size() > window_size / 2) {
+						window_size *= 2;
+					}
+					size_t size_request = estimateRequiredLumpSumBufferSpace(window_size, options);
+					TextBuffer buf;
+					if (buf.reserve(size_request, ec), ec) {
+						return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("failure while preparing buffer space ({}) for file \"{}\": error {}:{}", HumanReadable(size_request).to_string(), p.generic_string(), ec.value(), ec.message())}};
+					}
+					work.file_content = std::move(buf);
+				}
+				// as `file_content` IS `reader.data` during the read, we swap it in and out again: no copying.
+				std::swap(reader.data, work.file_content);
+				memcpy(reader.data.data(), carry.data(), carry.size());
+				const size_t request = window_size - carry.size();
+				auto r = reader.readContentChunk(carry.size(), request);
+				std::swap(reader.data, work.file_content);
+				if (!r.has_value())
+					return std::unexpected{r.error()};
+				eof = (r.value() < request);
+
+				const size_t filled = carry.size() + r.value();
+				const char *ptr = work.file_content.data();
+				size_t boundary = filled;
+				if (!eof) {
+					boundary = (want_paragraphs ? find_last_paragraph_break(ptr, filled) : find_last_line_break(ptr, filled));
+					if (boundary == 0) {
+						// not a single complete line/paragraph in the window: carry it all and grow the window.
+						carry.assign(ptr, filled);
+						continue;
+					}
+				}
+				// save the remainder before the parsers get to write their sentinels and scratch data beyond the chunk end.
+				carry.assign(ptr + boundary, filled - boundary);
+				work.file_content.set_content_size(boundary);
+				// release the scratch space taken by the previous chunk.
+				work.file_content.write_text_edge_sentinel();
+
+				work.lines.clear();
+				work.paragraphs.clear();
+				work.words.clear();
+				work.ngrams.clear();
 
 				if (options.mode & mode::ToTextLines) {
-					if (rv.parseContentAsLines(options, ec), ec) {
+					if (work.parseContentAsLines(options, ec), ec) {
 						return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\" into text lines: error {}:{}", p.generic_string(), ec.value(), ec.message())}};
 					}
 				}
-				if (options.mode & mode::ToParagraphs) {
-					if (rv.parseContentAsParagraphs(options, ec), ec) {
+				if (want_paragraphs) {
+					if (work.parseContentAsParagraphs(options, ec), ec) {
 						return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\" into text paragraphs: error {}:{}", p.generic_string(), ec.value(), ec.message())}};
 					}
 				}
-				if (options.mode & mode::ToWords) {
-					if (rv.parseContentAsWords(options, ec), ec) {
+				if ((options.mode & mode::ToWords) || want_ngrams) {
+					if (work.parseContentAsWords(options, ec), ec) {
 						return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\" into words: error {}:{}", p.generic_string(), ec.value(), ec.message())}};
 					}
 				}
-				if (options.mode & mode::ToNGrams) {
-					if (rv.parseContentAsNGrams(options, ec), ec) {
+				if (want_ngrams) {
+					// prefix the words with the tail of the previous chunk, so the n-grams continue seamlessly across the boundary.
+					const size_t tail_count = tail_words.size();
+					work.words.insert(work.words.begin(), tail_words.begin(), tail_words.end());
+					if (work.parseContentAsNGrams(options, ec), ec) {
 						return std::unexpected{ErrorResponse{std::errc::no_buffer_space, std::format("failure while processing file \"{}\" into ngrams: error {}:{}", p.generic_string(), ec.value(), ec.message())}};
 					}
+
+					// save the new tail: these words must outlive the chunk buffer, hence copy them.
+					// (the old tail text must stay alive while we do: some of the kept words may still be located in there.)
+					const size_t keep = std::min(ngram_overlap, work.words.size());
+					const size_t first = work.words.size() - keep;
+					std::string text;
+					for (size_t i = first; i < work.words.size(); i++) {
+						text += work.words[i];
+					}
+					tail_text.swap(text);
+					tail_words.clear();
+					for (size_t i = first, pos = 0; i < work.words.size(); i++) {
+						tail_words.push_back(std::string_view(tail_text).substr(pos, work.words[i].size()));
+						pos += work.words[i].size();
+					}
+
+					work.words.erase(work.words.begin(), work.words.begin() + tail_count);
 				}
-				return rv;
-			}
 
-			return std::unexpected{ErrorResponse{std::errc::no_such_file_or_directory, std::format("file \"{}\" does not exist.", p.generic_string())}};
+				if (!callback(work, offset)) {
+					return offset + boundary;
+				}
+				offset += boundary;
+			}
+			return offset;
 		});
 	}
 
 }
-
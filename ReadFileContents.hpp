@@ -1,9 +1,13 @@
 #pragma once
 
 #include "Base.hpp"
+#include "NGramDictionary.hpp"
+#include "CompactSpanList.hpp"
 
 #include <cstdint>
 #include <cstdio>
+#include <memory>
+#include <functional>
 
 
 namespace text_processing {
@@ -28,6 +32,36 @@ namespace text_processing {
 		bool unicode_normalization : 1 {false};
 
 		bool accept_comment_lines : 1 {false};
+
+		// store the lines and words in `ExtendedFileContent::compact_lines` / `compact_words` (8 bytes per span) instead of
+		// `lines` / `words` (16 bytes per span): for the (very) large files, where the span lists take more memory than the text.
+		bool compact_spans : 1 {false};
+
+		// count the lines up front (a vectorized pre-pass) and reserve the `lines` / `paragraphs` lists accordingly,
+		// instead of guessing their size from the content size. Pays off when the lines are much longer or much shorter
+		// than the ~10 bytes the guess assumes, e.g. path lists or word lists.
+		bool exact_reservation : 1 {false};
+
+		// how the file content is loaded into the `FileContent::file_content` buffer.
+		enum LoadMode : uint8_t {
+			ReadIntoBuffer = 0,
+			MemoryMapped,			// zero-copy: the content (and any views into it) is served straight from the OS page cache.
+			Pipelined,				// the content is read in blocks by a background thread, while the lines & words are split off the blocks already read. Does not combine with `exact_reservation` nor `split_thread_count` != 1.
+			DirectIO,				// cold read, bypassing the page cache (O_DIRECT), for one-shot corpus sweeps; falls back to ReadIntoBuffer where the filesystem refuses.
+		} load_mode = ReadIntoBuffer;
+
+		// the number of words per n-gram produced by `ExtendedFileContent::parseContentAsNGrams()`.
+		uint8_t ngram_size = 3;
+
+		// optional: allocate the file content buffer (plus scratch space) from this arena instead of the heap.
+		// Ignored for memory mapped files and direct I/O.
+		TextBufferArena *arena = nullptr;
+
+		// the number of threads `parseContentAsLines()` and `parseContentAsWords()` may use to split a (huge) buffer;
+		// 0: one per core. Content smaller than a few MB per thread is split by fewer threads.
+		//
+		// NOTE: the fused multi-mode `parseContent()` pass is always single-threaded.
+		unsigned split_thread_count = 1;
 	};
 
 	struct FileContent {
@@ -43,7 +77,7 @@ namespace text_processing {
 		// a map of pointers into the response file content, each describing one target line/word/element.
 		typedef std::vector<std::string_view> list;
 
-		typedef uint32_t ngram_id_t;
+		typedef NGramDictionary::ngram_id_t ngram_id_t;
 
 		typedef std::vector<ngram_id_t> ngram_list;
 
@@ -51,6 +85,17 @@ namespace text_processing {
 		list lines{};
 		list words{};
 
+		// the `FileContentProcessingOptions::compact_spans` alternatives for `lines` and `words`.
+		CompactSpanList compact_lines{};
+		CompactSpanList compact_words{};
+
+		// the n-grams of `words`, in order of appearance, as ids into `ngram_dictionary`.
+		ngram_list ngrams{};
+
+		// set this up front to share one dictionary among several files (and get comparable n-gram ids across them);
+		// otherwise `parseContentAsNGrams()` creates a fresh one.
+		std::shared_ptr<NGramDictionary> ngram_dictionary{};
+
 		ExtendedFileContent() = default;
 		ExtendedFileContent(const TextBuffer &s);
 		ExtendedFileContent(TextBuffer &&s);
@@ -59,19 +104,66 @@ namespace text_processing {
 		void parseContentAsParagraphs(const FileContentProcessingOptions& options, std::error_code &ec);
 		void parseContentAsWords(const FileContentProcessingOptions& options, std::error_code &ec);
 		void parseContentAsNGrams(const FileContentProcessingOptions& options, std::error_code &ec);
+
+		// incremental flavors of `parseContentAsLines()` / `parseContentAsWords()`: append the lines/words in the content
+		// range [start, end) to the list(s). `end` must be the content end or lie right beyond an EOL character, and the
+		// buffer must be readable for `TextBuffer::sentinel_size` bytes beyond `end`: the SIMD scanners overshoot.
+		// No reservations are made.
+		void parseContentRangeAsLines(size_t start, size_t end, const FileContentProcessingOptions& options, std::error_code &ec);
+		void parseContentRangeAsWords(size_t start, size_t end, const FileContentProcessingOptions& options, std::error_code &ec);
+
+		// parse the content into everything `options.mode` asks for. When that's more than one thing, all of it is
+		// produced in a single pass over the content.
+		void parseContent(const FileContentProcessingOptions& options, std::error_code &ec);
 	};
 
 	using FileContentParseResult = std::expected<FileContent, ErrorResponse>;
 	using ExtendedFileContentParseResult = std::expected<ExtendedFileContent, ErrorResponse>;
 
-	FileContentParseResult processFile(const path& filepath, const searchPaths& search_paths = {});
+	FileContentParseResult processFile(const path& filepath, const searchPaths& search_paths = {}, FileContentProcessingOptions::LoadMode load_mode = FileContentProcessingOptions::ReadIntoBuffer);
 
 	ExtendedFileContentParseResult processFileEx(const path& filepath, const searchPaths& search_paths = {}, const FileContentProcessingOptions& options = {});
 
+	// the buffer space `processFileEx()` allocates for a file of `filesize` bytes: the content plus the scratch space
+	// the parse options require.
+	size_t estimateRequiredLumpSumBufferSpace(std::uintmax_t filesize, const FileContentProcessingOptions& options);
+
+	// streaming alternative to `processFileEx()` for files which may be (much) larger than available memory.
+	//
+	// The file is read in windows of `chunk_size` bytes (0: use the default); each window is cut at its last line end (or
+	// its last empty line, when `ToParagraphs` is requested) and the remainder is carried over into the next window, so no
+	// line or paragraph is ever split. The callback receives each chunk as an `ExtendedFileContent`, whose `file_content`
+	// carries only the chunk's text and whose `lines`/`paragraphs`/`words`/`ngrams` reference it; all of it is only valid
+	// during the callback. The `ngrams` include those straddling the previous chunk boundary, and one `ngram_dictionary`
+	// is kept for the entire file. `offset` is the file offset of the chunk's text.
+	//
+	// Return `false` from the callback to stop early. Returns the number of bytes processed.
+	//
+	// Memory use is bounded by the chunk size (plus the scratch space the parse options require), unless a single line or
+	// paragraph is larger than that: then the window grows to fit.
+	//
+	// NOTE: `options.load_mode` and `options.compact_spans` are ignored: chunks are always read into a buffer and the
+	// chunks are small enough for the regular span lists.
+	using FileContentChunkCallback = std::function<bool(const ExtendedFileContent &chunk, std::uintmax_t offset)>;
+
+	std::expected<std::uintmax_t, ErrorResponse> processFileInChunks(const path& filepath, const FileContentChunkCallback &callback, const searchPaths& search_paths = {}, const FileContentProcessingOptions& options = {}, size_t chunk_size = 0);
+
 	// -----------------------------------------------------------------------
 
 	struct FileReader {
 		FILE* handle = nullptr;
+#if !defined(_WIN32)
+		// the raw file descriptor, when the file was opened by `openRaw()` or `openDirect()`; `handle` is not used then.
+		int fd = -1;
+		// set when `fd` has been opened for direct (unbuffered) I/O.
+		bool direct_io = false;
+#endif
+
+		// O_DIRECT wants buffer address, file offset and transfer size aligned to the logical block size of the device:
+		// 4K covers both the 512 byte and the 4K sector crowd.
+		static constexpr const size_t direct_io_alignment = 4096;
+		// the largest single O_DIRECT read we issue (Linux caps any single read at just under 2GB anyway).
+		static constexpr const size_t max_direct_io_transfer = 64 * 1024 * 1024;
 
 		TextBuffer data;
 
@@ -80,11 +172,50 @@ namespace text_processing {
 		~FileReader();
 
 		std::optional<ErrorResponse> open(const path &filepath);
+
+		// POSIX: open the file using a raw `open(O_CLOEXEC)`, take the file size from the open handle (`fstat()`) and
+		// announce sequential access (`posix_fadvise()`): the path is resolved only once and the size is that of the
+		// file we're actually reading. Elsewhere: `open()` plus `fs::file_size()`. Returns the file size.
+		std::expected<std::uintmax_t, ErrorResponse> openRaw(const path &filepath);
+
+		// like `openRaw()`, but bypass the page cache (O_DIRECT) for cold, one-shot reads: a sweep over a corpus that
+		// doesn't fit in memory anyway should not evict everybody's hot working set. When the filesystem refuses O_DIRECT
+		// (tmpfs, some network filesystems, ...), the file is opened for buffered reads and `direct_io` remains false.
+		std::expected<std::uintmax_t, ErrorResponse> openDirect(const path &filepath);
+
 		void close(void);
 
+		// the OS file descriptor of the open file, or -1.
+		int descriptor(void) const;
+
 		bool reserve_bufferspace(size_t amount);
 
 		std::expected<size_t, ErrorResponse> readAllContent(size_t amount);
+
+		// read until EOF, starting out with `expected_size` (the size at open time): when the file turns out to be
+		// larger, the buffer grows. The buffer may have been reserved already, e.g. with scratch space; if not, it is
+		// reserved here.
+		std::expected<size_t, ErrorResponse> readAllContentUntilEOF(size_t expected_size);
+
+		// the `openDirect()` companion of `readAllContentUntilEOF()`: `data` must either be unreserved or reserved
+		// with `TextBuffer::reserve_aligned(..., direct_io_alignment, ...)`. Reads buffered when `direct_io` is not set
+		// and drops the pages read from the page cache afterwards.
+		std::expected<size_t, ErrorResponse> readAllContentDirect(size_t expected_size);
+
+		// helper for the above: continue reading at buffer offset `total` until EOF, growing the buffer as needed.
+		std::expected<size_t, ErrorResponse> readRemainingContentUntilEOF(size_t total);
+
+		// read up to `amount` bytes into `data`, starting at buffer offset `offset`; the content size is set to
+		// `offset` plus the number of bytes read. The buffer must already be large enough.
+		std::expected<size_t, ErrorResponse> readContentChunk(size_t offset, size_t amount);
+
+		// read up to `amount` bytes into `dst`, without touching `data`: for filling a buffer from another thread.
+		std::expected<size_t, ErrorResponse> readContentBlock(char *dst, size_t amount);
+
+		// zero-copy alternative to `readAllContent()`: map the file content into `data` instead of reading it.
+		// `requested_buffer_size` is the total buffer size, i.e. including the sentinel and any scratch space needed
+		// by the content rewriting passes downrange.
+		std::expected<size_t, ErrorResponse> mapAllContent(size_t amount, size_t requested_buffer_size);
 	};
 
 
@@ -13,6 +13,7 @@
 
 #include "ReadFileContents.hpp"
 #include "PrivateUtilities.hpp"
+#include "FileLookupCache.hpp"
 
 #if defined(_WIN32)
 #ifndef _CRT_DECLARE_NONSTDC_NAMES
@@ -50,7 +51,8 @@ namespace text_processing {
 		.accept_comment_lines = true
 		};
 		return processFileEx(filepath, search_paths, proc_opts).and_then([&](ExtendedFileContent &&content) -> ResponseFileParseResult {
-			ResponseFilesSet rv(content.file_content);
+			// hand the buffer over: `content.lines` keep pointing into it, so that's all it takes.
+			ResponseFilesSet rv(std::move(content.file_content));
 			return internalProcessAsResponseFile(rv, content.lines, filepath.generic_string(), search_paths, options);
 		});
 	}
@@ -66,7 +68,7 @@ namespace text_processing {
 		exfcontent.file_content = std::move(buf);
 		std::error_code ec;
 		if (exfcontent.parseContentAsLines(proc_opts, ec), ec) {
-			return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("failure while parsing buffer space ({}) for response file \"{}\": error {}:{}", HumanReadable(exfcontent.file_content.content_size()).to_string(), filepath, ec.value(), ec.message())}};
+			return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("failure while parsing buffer space ({}) for response file \"{}\": error {}:{}", HumanReadable(exfcontent.file_content.content_length()).to_string(), filepath, ec.value(), ec.message())}};
 		}
 		ResponseFilesSet rv(std::move(exfcontent.file_content));
 		return internalProcessAsResponseFile(rv, exfcontent.lines, filepath, search_paths, options);
@@ -83,20 +85,30 @@ namespace text_processing {
 		exfcontent.file_content = std::move(buf);
 		std::error_code ec;
 		if (exfcontent.parseContentAsLines(proc_opts, ec), ec) {
-			return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("failure while parsing buffer space ({}) for response file \"{}\": error {}:{}", HumanReadable(exfcontent.file_content.content_size()).to_string(), filepath, ec.value(), ec.message())}};
+			return std::unexpected{ErrorResponse{std::errc::not_enough_memory, std::format("failure while parsing buffer space ({}) for response file \"{}\": error {}:{}", HumanReadable(exfcontent.file_content.content_length()).to_string(), filepath, ec.value(), ec.message())}};
 		}
 		ResponseFilesSet rv(std::move(exfcontent.file_content));
 		return internalProcessAsResponseFile(rv, exfcontent.lines, filepath, search_paths, options);
 	}
 
+	// -----------------------------------------------------------------------------------------------------
+
 	static ResponseFileParseResult internalProcessAsResponseFile(ResponseFilesSet &data, const line_list& lines, const std::string& filepath, const searchPaths& search_paths, const ResponsefileProcessingOptions &options) {
 		// reserve the number of lines that were be found: each will result in a target path if all goes well...
 		data.files.reserve(lines.size());
 
+		// resolving hundreds of thousands of paths one by one is costly: have them served from a lookup cache instead.
+		// This fetches the current working directory once and each directory is normalized & scanned (at most) once.
+		std::optional<FileLookupCache> local_cache;
+		FileLookupCache *lookup_cache = options.lookup_cache;
+		if (!lookup_cache) {
+			lookup_cache = &local_cache.emplace();
+		}
+
 		uintmax_t failure_count = 0;
 		for (const auto line : lines) {
 			path f(line);
-			auto lr = locateFile(f, filepath, search_paths, options.specfile_path_is_also_search_path, options.accept_absolute_paths, options.accept_relative_paths);
+			auto lr = locateFile(f, filepath, search_paths, options.specfile_path_is_also_search_path, options.accept_absolute_paths, options.accept_relative_paths, lookup_cache);
 			if (!lr.has_value()) {
 				failure_count++;
 				if (!options.tolerated_nonexist_ratio) {
@@ -109,6 +121,8 @@ namespace text_processing {
 				if (options.tolerated_nonexist_ratio < score) {
 					return std::unexpected{ErrorResponse{std::errc::wrong_protocol_type, std::format("file \"{}\" is not a response file: the (estimated) line faults score is too high: {}/{} > {}.", filepath, failure_count, data.files.capacity(), options.tolerated_nonexist_ratio)}};
 				}
+				// tolerated: skip this one.
+				continue;
 			}
 
 			//lines.push_back(line);
@@ -28,6 +28,10 @@ namespace text_processing {
 		bool accept_comment_lines{true};
 
 		bool specfile_path_is_also_search_path{true};
+
+		// optional: share a lookup cache among response files referencing the same directories.
+		// When not set, a cache is set up for the duration of the `processAsResponseFile()` call.
+		FileLookupCache *lookup_cache = nullptr;
 	};
 
 	struct ResponseFilesSet : public FileContent {
@@ -1,31 +1,1251 @@
 
 #include "Base.hpp"
+#include "ReadFileContents.hpp"
+#include "CorpusLoader.hpp"
+#include "FileLookupCache.hpp"
+#include "FileBatchReader.hpp"
+#include "PrivateUtf8Scanning.hpp"
+#include "PrivateUtf16Transcoding.hpp"
+#include "RawTextIngest.hpp"
+#include "CodeStripping.hpp"
 
 #include <gtest/gtest.h>
 #include <cstdio>
+#include <random>
 
 using namespace text_processing;
 
 
+template <class List>
+static std::vector<std::string> as_strings(const List &l) {
+	return {l.begin(), l.end()};
+}
 
+TEST(ContentSplitting, LinesTrimAndComments) {
+	ExtendedFileContent c(TextBuffer("  alpha \t\r\n# comment\n\n\tbeta\rgamma delta\f  # indented comment\n  \v \nlast"));
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToTextLines,
+		.trim_outer_whitespace = true,
+		.accept_comment_lines = true
+	};
+	std::error_code ec;
+	c.parseContentAsLines(opts, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_EQ(as_strings(c.lines), (std::vector<std::string>{"alpha", "beta", "gamma delta", "last"}));
+}
 
+TEST(ContentSplitting, LinesWithoutOptionsKeepWhitespaceAndHashes) {
+	ExtendedFileContent c(TextBuffer(" a \r\n#b\n\n  \n"));
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToTextLines,
+	};
+	std::error_code ec;
+	c.parseContentAsLines(opts, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_EQ(as_strings(c.lines), (std::vector<std::string>{" a ", "#b", "  "}));
+}
 
+// lines of every length 0..99, with a mix of line terminators: the line edges land at every possible offset within the SIMD blocks.
+TEST(ContentSplitting, LinesAtAllBlockOffsets) {
+	static const char *eols[] = {"\n", "\r\n", "\r", "\f", "\n\n"};
+	std::string text;
+	std::vector<std::string> expected;
+	for (int i = 0; i < 100; i++) {
+		std::string line;
+		for (int j = 0; j < i; j++) {
+			line += static_cast<char>(j % 7 == 3 ? ' ' : j % 5 == 1 ? '\xC3' : 'a' + j % 26);
+		}
+		text += std::string(i % 3, ' ') + line + std::string(i % 4, '\t') + eols[i % 5];
+		while (!line.empty() && line.back() == ' ')
+			line.pop_back();
+		while (!line.empty() && line.front() == ' ')
+			line.erase(0, 1);
+		if (!line.empty())
+			expected.push_back(line);
+	}
 
+	ExtendedFileContent c(TextBuffer(text.c_str()));
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToTextLines,
+		.trim_outer_whitespace = true,
+	};
+	std::error_code ec;
+	c.parseContentAsLines(opts, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_EQ(as_strings(c.lines), expected);
+}
 
 
+TEST(ContentSplitting, WordsAreUtf8Aware) {
+	ExtendedFileContent c(TextBuffer("Don't re-use e-mail -- \xC2\xABquoted\xC2\xBB na\xC3\xAFve\xE2\x80\x94" "dash \xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E x\xC2\xA0y 'edge- ok_1 \xE9t\xE9"));
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToWords,
+	};
+	std::error_code ec;
+	c.parseContentAsWords(opts, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_EQ(as_strings(c.words), (std::vector<std::string>{"Don't", "re-use", "e-mail", "quoted", "na\xC3\xAFve", "dash", "\xE6\x97\xA5", "\xE6\x9C\xAC", "\xE8\xAA\x9E", "x", "y", "edge", "ok_1", "\xE9t\xE9"}));
+}
 
+TEST(ContentSplitting, ParagraphsWithMixedLineEndings) {
+	const std::string_view text = "  First para\r\nline two  \r\n\r\nSecond\rpara\r\r\n\nThird\n \t\nFourth\fFifth";
+	ExtendedFileContent c(TextBuffer(text, 2 * text.size() + 64));
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToParagraphs,
+		.trim_outer_whitespace = true,
+	};
+	std::error_code ec;
+	c.parseContentAsParagraphs(opts, ec);
+	ASSERT_FALSE(ec);
+	// zero-copy: views into the source text
+	EXPECT_EQ(as_strings(c.paragraphs), (std::vector<std::string>{"First para\r\nline two", "Second\rpara", "Third", "Fourth", "Fifth"}));
+	EXPECT_EQ(c.paragraphs[0].data(), c.file_content.data() + 2);
+}
 
+TEST(ContentSplitting, ParagraphsAreRewrittenIntoScratchSpace) {
+	const std::string_view text = "    An exam-\r\n      ple of hyphen-\n    ation and Smith-\n    Jones\n\n  \tindented\n    more\n";
+	// room for two rewrites: each keeps its own scratch space.
+	ExtendedFileContent c(TextBuffer(text, 3 * text.size() + 96));
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToParagraphs,
+		.dedent_lines = true,
+		.contract_hyphenated_words_at_EOL = true,
+	};
+	std::error_code ec;
+	c.parseContentAsParagraphs(opts, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_EQ(as_strings(c.paragraphs), (std::vector<std::string>{"An example of hyphenation and Smith-\nJones", "indented\n more"}));
+	// NUL-terminated, in the scratch space
+	EXPECT_EQ(c.paragraphs[0].data()[c.paragraphs[0].size()], 0);
+	EXPECT_GE(c.paragraphs[0].data(), c.file_content.data() + text.size() + TextBuffer::sentinel_size);
 
+	opts.contract_lines_in_paragraph = true;
+	c.parseContentAsParagraphs(opts, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_EQ(as_strings(c.paragraphs), (std::vector<std::string>{"An example of hyphenation and Smith- Jones", "indented more"}));
+}
+
+TEST(ContentSplitting, LastParagraphWithoutTerminatorFitsTheScratchSpace) {
+	// just enough scratch space for the rewrite: the content plus a sentinel.
+	ExtendedFileContent c(TextBuffer("ab", 2, 2 * (2 + TextBuffer::sentinel_size)));
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToParagraphs,
+		.dedent_lines = true,
+	};
+	std::error_code ec;
+	c.parseContentAsParagraphs(opts, ec);
+	ASSERT_FALSE(ec);
+	ASSERT_EQ(as_strings(c.paragraphs), (std::vector<std::string>{"ab"}));
+	// NUL-terminated, and that NUL plus the rest of the sentinel stay within the buffer.
+	const char *end = c.paragraphs[0].data() + c.paragraphs[0].size();
+	EXPECT_EQ(end[0], 0);
+	EXPECT_LE(end + TextBuffer::sentinel_size, c.file_content.data() + c.file_content.capacity());
+}
 
+TEST(ContentSplitting, FusedParseMatchesSeparatePasses) {
+	std::string text;
+	for (int i = 0; i < 50; i++) {
+		text += std::format("  # note {}\r\nThe quick-\r\nbrown fox {} jumps\tover\n\xE6\x97\xA5\xE6\x9C\xAC don't  \r\r\n", i, i);
+		if (i % 7 == 0)
+			text += "\f\n   \n";
+	}
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ParseMode(FileContentProcessingOptions::ToTextLines | FileContentProcessingOptions::ToParagraphs | FileContentProcessingOptions::ToWords | FileContentProcessingOptions::ToNGrams),
+		.trim_outer_whitespace = true,
+		.contract_hyphenated_words_at_EOL = true,
+		.contract_lines_in_paragraph = true,
+		.accept_comment_lines = true,
+	};
+	std::error_code ec;
 
+	ExtendedFileContent fused(TextBuffer(text, 3 * text.size() + 64));
+	fused.parseContent(opts, ec);
+	ASSERT_FALSE(ec);
 
+	ExtendedFileContent separate(TextBuffer(text, 3 * text.size() + 64));
+	separate.parseContentAsLines(opts, ec);
+	ASSERT_FALSE(ec);
+	separate.parseContentAsParagraphs(opts, ec);
+	ASSERT_FALSE(ec);
+	separate.parseContentAsWords(opts, ec);
+	ASSERT_FALSE(ec);
+	separate.parseContentAsNGrams(opts, ec);
+	ASSERT_FALSE(ec);
+
+	EXPECT_EQ(as_strings(fused.lines), as_strings(separate.lines));
+	EXPECT_EQ(as_strings(fused.paragraphs), as_strings(separate.paragraphs));
+	EXPECT_EQ(as_strings(fused.words), as_strings(separate.words));
+	EXPECT_EQ(fused.ngrams, separate.ngrams);
+	EXPECT_EQ(fused.lines.size(), 150u);
+	EXPECT_EQ(fused.paragraphs.size(), 50u);
+	EXPECT_EQ(fused.ngram_dictionary->ngram_text(fused.ngrams[0]), "note 0 The");
+	EXPECT_EQ(fused.paragraphs[0], "# note 0 The quickbrown fox 0 jumps\tover \xE6\x97\xA5\xE6\x9C\xAC don't");
+}
 
+TEST(ContentSplitting, NGramsShareOneDictionary) {
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToNGrams,
+		.ngram_size = 2,
+	};
+	std::error_code ec;
 
+	ExtendedFileContent a(TextBuffer("the cat sat on the cat"));
+	a.parseContentAsNGrams(opts, ec);
+	ASSERT_FALSE(ec);
+	ASSERT_EQ(a.ngrams.size(), 5u);
+	EXPECT_EQ(a.ngrams[0], a.ngrams[4]);		// "the cat" twice
+	EXPECT_EQ(a.ngram_dictionary->size(), 4u);
+	EXPECT_EQ(a.ngram_dictionary->ngram_text(a.ngrams[2]), "sat on");
 
+	ExtendedFileContent b(TextBuffer("a cat sat on"));
+	b.ngram_dictionary = a.ngram_dictionary;
+	b.parseContentAsNGrams(opts, ec);
+	ASSERT_FALSE(ec);
+	ASSERT_EQ(b.ngrams.size(), 3u);
+	EXPECT_EQ(b.ngrams[1], a.ngrams[1]);		// "cat sat"
+	EXPECT_EQ(b.ngrams[2], a.ngrams[2]);		// "sat on"
+	EXPECT_EQ(a.ngram_dictionary->size(), 5u);
+
+	// a dictionary carries a single n-gram size only
+	opts.ngram_size = 3;
+	b.parseContentAsNGrams(opts, ec);
+	EXPECT_EQ(ec, std::errc::invalid_argument);
+}
+
+TEST(ContentSplitting, NGramSizeOutOfRangeIsRejected) {
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToNGrams,
+		.ngram_size = NGramDictionary::max_ngram_size + 1,
+	};
+	std::error_code ec;
+
+	ExtendedFileContent a(TextBuffer("the cat sat on the mat"));
+	a.parseContentAsNGrams(opts, ec);
+	EXPECT_EQ(ec, std::errc::invalid_argument);
+	EXPECT_FALSE(a.ngram_dictionary);
+
+	auto r = processFileEx("no-such-file.txt", searchPaths{}, opts);
+	ASSERT_FALSE(r.has_value());
+	EXPECT_EQ(r.error().code, std::errc::invalid_argument);
+}
+
+TEST(CompactSpanList, MatchesVectorAcrossBlocks) {
+	std::string text;
+	for (int i = 0; i < 70000; i++)
+		text += std::format("w{} ", i);
+
+	ExtendedFileContent::list reference;
+	CompactSpanList compact(text.data());
+	for (size_t i = 0; i < text.size(); ) {
+		size_t e = text.find(' ', i);
+		reference.emplace_back(text.data() + i, e - i);
+		compact.emplace_back(text.data() + i, e - i);
+		i = e + 1;
+	}
+	// out of order: lies before its block base, hence goes into the side table.
+	reference.push_back(std::string_view(text).substr(0, 2));
+	compact.push_back(std::string_view(text).substr(0, 2));
+
+	ASSERT_EQ(compact.size(), reference.size());
+	EXPECT_TRUE(std::equal(compact.begin(), compact.end(), reference.begin(), reference.end()));
+	EXPECT_EQ(compact[65536], "w65536");
+	EXPECT_EQ(compact.back(), "w0");
+	EXPECT_EQ(compact.end() - compact.begin(), ptrdiff_t(reference.size()));
+	EXPECT_EQ(*(compact.begin() + 3), "w3");
+	EXPECT_THROW(compact.at(compact.size()), std::out_of_range);
+	EXPECT_LT(compact.memory_usage(), reference.capacity() * sizeof(std::string_view));
+}
+
+TEST(ContentSplitting, CompactSpansMatchRegularLists) {
+	std::string text;
+	for (int i = 0; i < 40; i++)
+		text += std::format("  line {} has\tsome words  \r\n# comment {}\n\n", i, i);
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ParseMode(FileContentProcessingOptions::ToTextLines | FileContentProcessingOptions::ToNGrams),
+		.trim_outer_whitespace = true,
+		.accept_comment_lines = true,
+	};
+	std::error_code ec;
+
+	ExtendedFileContent regular(TextBuffer(text, text.size() + 64));
+	regular.parseContent(opts, ec);
+	ASSERT_FALSE(ec);
+
+	opts.compact_spans = true;
+	ExtendedFileContent fused(TextBuffer(text, text.size() + 64));
+	fused.parseContent(opts, ec);
+	ASSERT_FALSE(ec);
+	ExtendedFileContent separate(TextBuffer(text, text.size() + 64));
+	separate.parseContentAsLines(opts, ec);
+	ASSERT_FALSE(ec);
+	separate.parseContentAsNGrams(opts, ec);
+	ASSERT_FALSE(ec);
+
+	EXPECT_TRUE(fused.lines.empty());
+	EXPECT_TRUE(fused.words.empty());
+	EXPECT_EQ(as_strings(fused.compact_lines), as_strings(regular.lines));
+	EXPECT_EQ(as_strings(fused.compact_words), as_strings(regular.words));
+	EXPECT_EQ(as_strings(separate.compact_lines), as_strings(regular.lines));
+	EXPECT_EQ(as_strings(separate.compact_words), as_strings(regular.words));
+	EXPECT_EQ(fused.ngrams, regular.ngrams);
+	EXPECT_EQ(separate.ngrams, regular.ngrams);
+}
+
+TEST(ContentSplitting, ExactReservationCountsLines) {
+	std::string text;
+	for (int i = 0; i < 100; i++) {
+		text += std::format("/some/long/path/to/file-{}.txt\r\n", i);
+		if (i % 10 == 9)
+			text += (i % 20 == 19 ? "\f" : "\r\n");
+	}
+	text += "no EOL at the end";
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToTextLines,
+	};
+	opts.exact_reservation = true;
+	std::error_code ec;
+
+	ExtendedFileContent c(TextBuffer(text, text.size() + 64));
+	c.parseContentAsLines(opts, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_EQ(c.lines.size(), 101u);
+	EXPECT_EQ(c.lines.capacity(), 101u);
+
+	c.parseContentAsParagraphs(opts, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_EQ(c.paragraphs.size(), 11u);
+	EXPECT_EQ(c.paragraphs.capacity(), 11u);
+}
+
+TEST(ContentSplitting, ParallelSplitMatchesSingleThreaded) {
+	// large enough for 3 chunks
+	std::string text;
+	for (int i = 0; text.size() < 13 * 1024 * 1024; i++) {
+		text += std::format("  line {} with\tsome words\r\n", i);
+		if (i % 1000 == 0)
+			text += "# a comment\n\n";
+	}
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ParseMode(FileContentProcessingOptions::ToTextLines | FileContentProcessingOptions::ToWords),
+		.trim_outer_whitespace = true,
+		.accept_comment_lines = true,
+	};
+	std::error_code ec;
+
+	ExtendedFileContent single(TextBuffer(text, text.size() + 64));
+	single.parseContentAsLines(opts, ec);
+	ASSERT_FALSE(ec);
+	single.parseContentAsWords(opts, ec);
+	ASSERT_FALSE(ec);
+
+	opts.split_thread_count = 3;
+	ExtendedFileContent parallel(TextBuffer(text, text.size() + 64));
+	parallel.parseContentAsLines(opts, ec);
+	ASSERT_FALSE(ec);
+	parallel.parseContentAsWords(opts, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_TRUE(parallel.lines == single.lines);
+	EXPECT_TRUE(parallel.words == single.words);
+
+	opts.compact_spans = true;
+	ExtendedFileContent compact(TextBuffer(text, text.size() + 64));
+	compact.parseContentAsLines(opts, ec);
+	ASSERT_FALSE(ec);
+	compact.parseContentAsWords(opts, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_TRUE(std::equal(compact.compact_lines.begin(), compact.compact_lines.end(), single.lines.begin(), single.lines.end()));
+	EXPECT_TRUE(std::equal(compact.compact_words.begin(), compact.compact_words.end(), single.words.begin(), single.words.end()));
+}
+
+TEST(ReadFileContents, ChunkedProcessingMatchesWholeFile) {
+	const path filepath = std::filesystem::temp_directory_path() / "text_processing_chunked_test.txt";
+	{
+		std::ofstream f(filepath, std::ios::binary);
+		for (int i = 0; i < 200; i++) {
+			f << "line " << i << " of the test\r\n";
+			if (i % 37 == 0)
+				f << std::string(300, 'x') << "\n";		// longer than a chunk
+		}
+		f << "no EOL at the end";
+	}
+
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ParseMode(FileContentProcessingOptions::ToTextLines | FileContentProcessingOptions::ToNGrams),
+	};
+	auto whole = processFileEx(filepath, {}, opts);
+	ASSERT_TRUE(whole.has_value());
+
+	std::vector<std::string> lines;
+	std::vector<std::string> ngrams;
+	size_t chunk_count = 0;
+	auto r = processFileInChunks(filepath, [&](const ExtendedFileContent &chunk, std::uintmax_t offset) {
+		chunk_count++;
+		for (auto l : chunk.lines)
+			lines.emplace_back(l);
+		for (auto id : chunk.ngrams)
+			ngrams.push_back(chunk.ngram_dictionary->ngram_text(id));
+		return true;
+	}, {}, opts, 128);
+	std::filesystem::remove(filepath);
+
+	ASSERT_TRUE(r.has_value());
+	EXPECT_EQ(r.value(), whole.value().file_content.content_length());
+	EXPECT_GT(chunk_count, 10u);
+	EXPECT_EQ(lines, as_strings(whole.value().lines));
+
+	std::vector<std::string> expected_ngrams;
+	for (auto id : whole.value().ngrams)
+		expected_ngrams.push_back(whole.value().ngram_dictionary->ngram_text(id));
+	EXPECT_EQ(ngrams, expected_ngrams);
+}
 
+TEST(ReadFileContents, ChunkedParagraphsKeepTheirIndent) {
+	const path filepath = std::filesystem::temp_directory_path() / "text_processing_chunked_paragraphs_test.txt";
+	{
+		std::ofstream f(filepath, std::ios::binary);
+		for (int i = 0; i < 40; i++) {
+			f << std::string(2 + i % 5, ' ') << "paragraph " << i << "\n" << std::string(4 + i % 3, ' ') << "second line\n";
+			f << (i % 2 ? "\n" : "\r\n\r\n");
+		}
+	}
 
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToParagraphs,
+		.dedent_lines = true,
+	};
+	auto whole = processFileEx(filepath, {}, opts);
+	ASSERT_TRUE(whole.has_value());
+	ASSERT_EQ(whole.value().paragraphs.size(), 40u);
 
+	std::vector<std::string> paragraphs;
+	auto r = processFileInChunks(filepath, [&](const ExtendedFileContent &chunk, std::uintmax_t offset) {
+		for (auto p : chunk.paragraphs)
+			paragraphs.emplace_back(p);
+		return true;
+	}, {}, opts, 64);
+	std::filesystem::remove(filepath);
 
+	ASSERT_TRUE(r.has_value());
+	EXPECT_EQ(paragraphs, as_strings(whole.value().paragraphs));
+}
+
+TEST(ReadFileContents, PipelinedLoadMatchesPlainLoad) {
+	const path filepath = std::filesystem::temp_directory_path() / "text_processing_pipelined_test.txt";
+	{
+		std::ofstream f(filepath, std::ios::binary);
+		for (int i = 0; i < 150000; i++) {
+			f << "line " << i << " of the\ttest\r\n";
+			if (i % 1000 == 0)
+				f << "\n# comment " << std::string(200, 'x') << "\n\n";
+		}
+		f << "no EOL at the end";
+	}
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ParseMode(FileContentProcessingOptions::ToTextLines | FileContentProcessingOptions::ToParagraphs | FileContentProcessingOptions::ToNGrams),
+		.trim_outer_whitespace = true,
+		.accept_comment_lines = true,
+	};
+
+	auto plain = processFileEx(filepath, {}, opts);
+	ASSERT_TRUE(plain.has_value());
+	opts.load_mode = FileContentProcessingOptions::Pipelined;
+	auto pipelined = processFileEx(filepath, {}, opts);
+	ASSERT_TRUE(pipelined.has_value());
+	opts.compact_spans = true;
+	auto compact = processFileEx(filepath, {}, opts);
+	ASSERT_TRUE(compact.has_value());
+	std::filesystem::remove(filepath);
+
+	EXPECT_EQ(pipelined->file_content.content_view(), plain->file_content.content_view());
+	EXPECT_TRUE(pipelined->lines == plain->lines);
+	EXPECT_TRUE(pipelined->words == plain->words);
+	EXPECT_TRUE(pipelined->paragraphs == plain->paragraphs);
+	EXPECT_EQ(pipelined->ngrams, plain->ngrams);
+	EXPECT_EQ(pipelined->lines.size(), 150001u);
+	EXPECT_TRUE(std::equal(compact->compact_lines.begin(), compact->compact_lines.end(), plain->lines.begin(), plain->lines.end()));
+	EXPECT_TRUE(std::equal(compact->compact_words.begin(), compact->compact_words.end(), plain->words.begin(), plain->words.end()));
+	EXPECT_EQ(compact->ngrams, plain->ngrams);
+
+	// these need all of the content up front.
+	opts.exact_reservation = true;
+	auto r = processFileEx(filepath, {}, opts);
+	ASSERT_FALSE(r.has_value());
+	EXPECT_EQ(r.error().code, std::errc::invalid_argument);
+	opts.exact_reservation = false;
+	opts.split_thread_count = 0;
+	r = processFileEx(filepath, {}, opts);
+	ASSERT_FALSE(r.has_value());
+	EXPECT_EQ(r.error().code, std::errc::invalid_argument);
+	opts.split_thread_count = 1;
+
+#if defined(__linux__)
+	// read until EOF: stat says 0 bytes, but there's content all the same. (As if the file grew after we opened it.)
+	opts.compact_spans = false;
+	opts.load_mode = FileContentProcessingOptions::ReadIntoBuffer;
+	plain = processFileEx("/proc/self/cmdline", {}, opts);
+	ASSERT_TRUE(plain.has_value());
+	opts.load_mode = FileContentProcessingOptions::Pipelined;
+	pipelined = processFileEx("/proc/self/cmdline", {}, opts);
+	ASSERT_TRUE(pipelined.has_value());
+	EXPECT_GT(pipelined->file_content.content_length(), 0u);
+	EXPECT_EQ(pipelined->file_content.content_view(), plain->file_content.content_view());
+	EXPECT_TRUE(pipelined->lines == plain->lines);
+	EXPECT_TRUE(pipelined->words == plain->words);
+	EXPECT_TRUE(pipelined->paragraphs == plain->paragraphs);
+#endif
+}
+
+TEST(ReadFileContents, RawReaderReadsUntilEOF) {
+	const path filepath = std::filesystem::temp_directory_path() / "text_processing_raw_reader_test.txt";
+	std::string expected;
+	for (int i = 0; i < 20000; i++) {
+		expected += std::format("line {}\n", i);
+	}
+	{
+		std::ofstream f(filepath, std::ios::binary);
+		f << expected;
+	}
+
+	FileReader reader;
+	auto filesize = reader.openRaw(filepath);
+	ASSERT_TRUE(filesize.has_value());
+	EXPECT_EQ(filesize.value(), expected.size());
+	EXPECT_GE(reader.descriptor(), 0);
+	auto len = reader.readAllContentUntilEOF(filesize.value());
+	ASSERT_TRUE(len.has_value());
+	EXPECT_EQ(reader.data.content_view(), expected);
+	reader.close();
+	EXPECT_EQ(reader.descriptor(), -1);
+
+	// a file which turns out larger than announced: the buffer must grow.
+	FileReader grower;
+	ASSERT_TRUE(grower.openRaw(filepath).has_value());
+	len = grower.readAllContentUntilEOF(10);
+	ASSERT_TRUE(len.has_value());
+	EXPECT_EQ(len.value(), expected.size());
+	EXPECT_EQ(grower.data.content_view(), expected);
+	EXPECT_EQ(grower.data.data()[expected.size()], 0);
+	grower.close();
+
+	auto r = processFileEx(filepath, {}, FileContentProcessingOptions{ .mode = FileContentProcessingOptions::ToTextLines });
+	std::filesystem::remove(filepath);
+	ASSERT_TRUE(r.has_value());
+	EXPECT_EQ(r->lines.size(), 20000u);
+
+	EXPECT_FALSE(FileReader{}.openRaw(filepath).has_value());
+}
+
+TEST(ReadFileContents, DirectIOMatchesPlainLoad) {
+	const path filepath = std::filesystem::temp_directory_path() / "text_processing_direct_io_test.txt";
+	std::string expected;
+	for (int i = 0; i < 200000; i++) {
+		expected += std::format("line {} of the direct I/O test\n", i);
+	}
+	expected += "no EOL at the end";	// an odd size: the last block comes back short
+	{
+		std::ofstream f(filepath, std::ios::binary);
+		f << expected;
+	}
+
+	auto plain = processFile(filepath, {}, FileContentProcessingOptions::ReadIntoBuffer);
+	ASSERT_TRUE(plain.has_value());
+	auto direct = processFile(filepath, {}, FileContentProcessingOptions::DirectIO);
+	ASSERT_TRUE(direct.has_value());
+	EXPECT_EQ(direct->file_content.content_view(), expected);
+	EXPECT_EQ(direct->file_content.content_view(), plain->file_content.content_view());
+
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ParseMode(FileContentProcessingOptions::ToTextLines | FileContentProcessingOptions::ToWords),
+	};
+	auto plain_ex = processFileEx(filepath, {}, opts);
+	ASSERT_TRUE(plain_ex.has_value());
+	opts.load_mode = FileContentProcessingOptions::DirectIO;
+	auto direct_ex = processFileEx(filepath, {}, opts);
+	ASSERT_TRUE(direct_ex.has_value());
+	EXPECT_TRUE(direct_ex->lines == plain_ex->lines);
+	EXPECT_TRUE(direct_ex->words == plain_ex->words);
+	EXPECT_EQ(direct_ex->lines.size(), 200001u);
+
+	// a (much) too small size estimate: the aligned buffer must grow, keeping its alignment.
+	FileReader reader;
+	ASSERT_TRUE(reader.openDirect(filepath).has_value());
+	auto len = reader.readAllContentDirect(10);
+	ASSERT_TRUE(len.has_value());
+	EXPECT_EQ(reader.data.content_view(), expected);
+	EXPECT_EQ(reader.data.data()[expected.size()], 0);
+	reader.close();
+	std::filesystem::remove(filepath);
+
+	TextBuffer aligned;
+	std::error_code ec;
+	aligned.reserve_aligned(5000, FileReader::direct_io_alignment, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_EQ(aligned.storage_kind(), TextBuffer::StorageKind::Aligned);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned.data()) % FileReader::direct_io_alignment, 0u);
+	EXPECT_EQ(aligned.capacity() % FileReader::direct_io_alignment, 0u);
+	EXPECT_GE(aligned.capacity(), 5000 + TextBuffer::sentinel_size);
+	aligned.grow(100000, ec);
+	ASSERT_FALSE(ec);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned.data()) % FileReader::direct_io_alignment, 0u);
+	EXPECT_GE(aligned.capacity(), 100000 + TextBuffer::sentinel_size);
+}
+
+TEST(CorpusLoader, DeliversInOrderWithinBudget) {
+	ResponseFilesSet corpus;
+	for (int i = 0; i < 20; i++) {
+		path filepath = std::filesystem::temp_directory_path() / std::format("text_processing_corpus_test_{}.txt", i);
+		std::ofstream f(filepath, std::ios::binary);
+		f << "file " << i << "\n" << std::string(100 * i, 'z') << "\n";
+		corpus.files.push_back(filepath);
+	}
+	corpus.files.push_back(std::filesystem::temp_directory_path() / "text_processing_corpus_test_nonexistent.txt");
+
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ToTextLines,
+	};
+	CorpusLoadingOptions corpus_opts{
+		.thread_count = 4,
+		.max_in_flight_bytes = 1000,
+	};
+	std::vector<size_t> order;
+	size_t failures = 0;
+	auto r = loadCorpus(corpus, [&](size_t index, const path &filepath, ExtendedFileContentParseResult &&result) {
+		order.push_back(index);
+		if (!result.has_value()) {
+			failures++;
+		} else {
+			EXPECT_EQ(result.value().lines.at(0), std::format("file {}", index));
+		}
+		return true;
+	}, opts, corpus_opts);
+
+	ASSERT_TRUE(r.has_value());
+	EXPECT_EQ(r.value(), corpus.files.size());
+	EXPECT_EQ(failures, 1u);
+	ASSERT_EQ(order.size(), corpus.files.size());
+	for (size_t i = 0; i < order.size(); i++)
+		EXPECT_EQ(order[i], i);
+
+	// the workers don't share the (not thread-safe) arena: each file gets a heap buffer of its own.
+	TextBufferArena arena;
+	opts.arena = &arena;
+	size_t loaded = 0;
+	r = loadCorpus(corpus, [&](size_t index, const path &, ExtendedFileContentParseResult &&result) {
+		if (result.has_value()) {
+			loaded++;
+			EXPECT_EQ(result.value().file_content.storage_kind(), TextBuffer::StorageKind::Heap);
+			EXPECT_EQ(result.value().lines.at(0), std::format("file {}", index));
+		}
+		return true;
+	}, opts, corpus_opts);
+	ASSERT_TRUE(r.has_value());
+	EXPECT_EQ(loaded, corpus.files.size() - 1);
+	EXPECT_EQ(arena.slab_space(), 0u);
+	opts.arena = nullptr;
+
+	// abort after the first few
+	size_t seen = 0;
+	corpus_opts.deliver_in_order = false;
+	r = loadCorpus(corpus, [&](size_t, const path &, ExtendedFileContentParseResult &&) {
+		return ++seen < 3;
+	}, opts, corpus_opts);
+	ASSERT_TRUE(r.has_value());
+	EXPECT_EQ(r.value(), 3u);
+
+	for (size_t i = 0; i + 1 < corpus.files.size(); i++)
+		std::filesystem::remove(corpus.files[i]);
+}
+
+TEST(ResponseFileHandling, BatchedLookupMatchesLocateFile) {
+	namespace fs = std::filesystem;
+	const path root = fs::temp_directory_path() / "text_processing_respfile_test";
+	fs::remove_all(root);
+	fs::create_directories(root / "a" / "b");
+	fs::create_directories(root / "search");
+	std::string content;
+	std::vector<std::string> names;
+	for (int i = 0; i < 20; i++) {
+		std::ofstream(root / "a" / std::format("f{}.txt", i)) << i;
+		names.push_back(std::format("a/f{}.txt", i));
+	}
+	std::ofstream(root / "a" / "b" / "deep.txt") << "deep";
+	std::ofstream(root / "search" / "found-via-search-path.txt") << "s";
+	fs::create_symlink(root / "a" / "b", root / "a" / "link");
+	names.insert(names.end(), {"a/b/deep.txt", "a/b/../f3.txt", "a/link/deep.txt", "a/link", "./a/f7.txt", "found-via-search-path.txt", (root / "a" / "f1.txt").string(), "a/missing.txt", "nodir/missing.txt"});
+	for (const auto &n : names)
+		content += n + "\n";
+
+	const std::string respfile = (root / "list.rsp").string();
+	const searchPaths search_paths{root / "search"};
+	ResponsefileProcessingOptions opts{
+		.tolerated_nonexist_ratio = 0.5f,
+	};
+	auto r = processAsResponseFile(content, respfile, search_paths, opts);
+	ASSERT_TRUE(r.has_value()) << r.error().message;
+
+	searchPaths expected;
+	for (const auto &n : names) {
+		auto lr = locateFile(n, respfile, search_paths);
+		if (lr.has_value())
+			expected.push_back(lr.value());
+	}
+	fs::remove_all(root);
+
+	EXPECT_EQ(expected.size(), names.size() - 2);
+	EXPECT_EQ(r.value().files, expected);
+}
+
+TEST(FileBatchReader, BatchMatchesProcessFile) {
+	const path dir = std::filesystem::temp_directory_path() / "text_processing_batch_test";
+	std::filesystem::create_directories(dir);
+	std::vector<path> files;
+	for (int i = 0; i < 40; i++) {
+		files.push_back(dir / std::format("file{}.txt", i));
+		std::ofstream f(files.back(), std::ios::binary);
+		f << std::string(size_t(i) * 997, char('a' + i % 26)) << "\nfile " << i;
+	}
+	files.push_back(dir / "does-not-exist.txt");
+	files.push_back(dir / "empty.txt");
+	std::ofstream(files.back()).close();
+#if defined(__linux__)
+	// stat says 0 bytes, but there's content all the same.
+	files.push_back("/proc/self/cmdline");
+#endif
+
+	for (bool use_io_uring : {true, false}) {
+		auto results = processFileBatch(files, {}, FileBatchLoadingOptions{.queue_depth = 4, .use_io_uring = use_io_uring});
+		ASSERT_EQ(results.size(), files.size());
+		for (size_t i = 0; i < files.size(); i++) {
+			auto expected = processFile(files[i]);
+			ASSERT_EQ(results[i].has_value(), expected.has_value()) << files[i];
+			if (expected.has_value()) {
+				EXPECT_EQ(results[i]->file_content.content_view(), expected->file_content.content_view()) << files[i];
+				EXPECT_EQ(results[i]->file_content.data()[results[i]->file_content.content_length()], 0);
+			}
+		}
+		EXPECT_FALSE(results[40].has_value());
+		EXPECT_EQ(results[41]->file_content.content_length(), 0u);
+#if defined(__linux__)
+		EXPECT_GT(results[42]->file_content.content_length(), 0u);
+#endif
+	}
+	std::filesystem::remove_all(dir);
+}
+
+TEST(FileLookupCache, RemembersUntilInvalidated) {
+	namespace fs = std::filesystem;
+	const path root = fs::temp_directory_path() / "text_processing_lookup_cache_test";
+	fs::remove_all(root);
+	fs::create_directories(root);
+	std::ofstream(root / "present.txt") << "x";
+
+	FileLookupCache cache;
+	const searchPaths search_paths{root};
+	auto a = locateFile("present.txt", {}, search_paths, false, true, true, &cache);
+	ASSERT_TRUE(a.has_value());
+	EXPECT_EQ(a.value(), locateFile("present.txt", {}, search_paths, false).value());
+	EXPECT_FALSE(locateFile("late.txt", {}, search_paths, false, true, true, &cache).has_value());
+
+	// the negative lookup is remembered...
+	std::ofstream(root / "late.txt") << "y";
+	EXPECT_FALSE(locateFile("late.txt", {}, search_paths, false, true, true, &cache).has_value());
+
+	// ... until we say otherwise.
+	cache.invalidate(root);
+	EXPECT_TRUE(locateFile("late.txt", {}, search_paths, false, true, true, &cache).has_value());
+
+	fs::remove_all(root);
+}
+
+TEST(TextBufferArena, BatchOfBuffersInFewSlabs) {
+	TextBufferArena arena(4096);
+	std::error_code ec;
+	std::vector<TextBuffer> buffers;
+	for (int i = 0; i < 100; i++) {
+		TextBuffer b;
+		b.reserve(100, arena, ec);
+		ASSERT_FALSE(ec);
+		EXPECT_EQ(b.storage_kind(), TextBuffer::StorageKind::Arena);
+		EXPECT_EQ(reinterpret_cast<uintptr_t>(b.data()) % TextBufferArena::alignment, 0u);
+		memcpy(b.data(), "arena", 5);
+		b.set_content_size(5);
+		b.write_text_edge_sentinel();
+		buffers.push_back(std::move(b));
+	}
+	// a large one gets a slab of its own
+	TextBuffer big;
+	big.reserve(10000, arena, ec);
+	ASSERT_FALSE(ec);
+	const size_t space = arena.slab_space();
+	EXPECT_LT(space, 100 * 4096u);
+
+	// copies always land on the heap
+	TextBuffer copy(buffers[0]);
+	EXPECT_EQ(copy.storage_kind(), TextBuffer::StorageKind::Heap);
+	EXPECT_EQ(copy.content_view(), "arena");
+
+	buffers.clear();
+	big.clear();
+	arena.reset();
+	for (int i = 0; i < 100; i++) {
+		TextBuffer b;
+		b.reserve(100, arena, ec);
+		ASSERT_FALSE(ec);
+	}
+	EXPECT_EQ(arena.slab_space(), space);
+}
+
+TEST(TextBuffer, LoadSplitAndResponseFileNeverCopyContent) {
+	namespace fs = std::filesystem;
+	const path root = fs::temp_directory_path() / "text_processing_copy_count_test";
+	fs::remove_all(root);
+	fs::create_directories(root);
+	std::ofstream(root / "one.txt") << "one\ntwo three\n";
+	std::ofstream(root / "list.rsp") << "# files\none.txt\n";
+
+	const size_t before = TextBuffer::content_copy_count();
+
+	auto f = processFile(root / "one.txt");
+	ASSERT_TRUE(f.has_value());
+	FileContentProcessingOptions opts{
+		.mode = FileContentProcessingOptions::ParseMode(FileContentProcessingOptions::ToTextLines | FileContentProcessingOptions::ToWords),
+	};
+	auto ef = processFileEx(root / "one.txt", {}, opts);
+	ASSERT_TRUE(ef.has_value());
+	EXPECT_EQ(ef.value().words.size(), 3u);
+	auto rf = processAsResponseFile(root / "list.rsp");
+	ASSERT_TRUE(rf.has_value()) << rf.error().message;
+	EXPECT_EQ(rf.value().files.size(), 1u);
+
+	EXPECT_EQ(TextBuffer::content_copy_count(), before);
+
+	fs::remove_all(root);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// strict UTF-8 decoder: the length of the well-formed sequence at `s`, or 0.
+static size_t strict_utf8_sequence_length(const uint8_t *s, size_t n) {
+	const uint8_t c = s[0];
+	size_t len;
+	uint32_t cp;
+	if (c < 0x80)
+		return is_verbatim_ascii_byte(c) ? 1 : 0;
+	if (c >= 0xC2 && c < 0xE0) {
+		len = 2;
+		cp = c & 0x1F;
+	} else if (c >= 0xE0 && c < 0xF0) {
+		len = 3;
+		cp = c & 0x0F;
+	} else if (c >= 0xF0 && c < 0xF5) {
+		len = 4;
+		cp = c & 0x07;
+	} else {
+		return 0;
+	}
+	if (len > n)
+		return 0;
+	for (size_t k = 1; k < len; k++) {
+		if ((s[k] & 0xC0) != 0x80)
+			return 0;
+		cp = (cp << 6) | (s[k] & 0x3F);
+	}
+	if ((len == 3 && (cp < 0x800 || (cp >= 0xD800 && cp < 0xE000))) || (len == 4 && (cp < 0x10000 || cp > 0x10FFFF)))
+		return 0;
+	return len;
+}
+
+TEST(Utf8Scanning, VerbatimSpanStopsAtTheRightCharacter) {
+	std::mt19937 rng(42);
+	const std::string_view pieces[] = { "plain ASCII text, ", "\t", "\n", "caf\xC3\xA9 ", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\r", "\x7F", "\x01",
+		"\xC3", "\x80", "\xED\xA0\x80" /* surrogate */, "\xE0\x80\xAF" /* overlong */, "\xF4\x90\x80\x80" /* too large */, "\xFF" };
+
+	for (int round = 0; round < 2000; round++) {
+		std::string text;
+		const int n = 1 + rng() % 40;
+		for (int k = 0; k < n; k++) {
+			// mostly the clean stuff, sometimes the trouble:
+			const size_t pick = (rng() % 4 ? rng() % 6 : rng() % std::size(pieces));
+			text += pieces[pick];
+		}
+		const auto *src = reinterpret_cast<const uint8_t *>(text.data());
+		const size_t span = utf8_verbatim_span(src, text.size());
+		ASSERT_LE(span, text.size());
+
+		// the span must consist of whole, well-formed characters only:
+		size_t i = 0;
+		while (i < span) {
+			const size_t l = strict_utf8_sequence_length(src + i, text.size() - i);
+			ASSERT_GT(l, 0u) << "round " << round << " offset " << i;
+			i += l;
+		}
+		ASSERT_EQ(i, span) << "round " << round;
+	}
+
+	// the first byte needing attention in a long run of ASCII is found exactly:
+	std::string text(1000, 'x');
+	text[777] = '\r';
+	EXPECT_EQ(utf8_verbatim_span(reinterpret_cast<const uint8_t *>(text.data()), text.size()), 777u);
+	text[777] = '\t';
+	EXPECT_GE(utf8_verbatim_span(reinterpret_cast<const uint8_t *>(text.data()), text.size()), 1000u - 31);
+}
+
+
+static std::string utf16_bytes(std::u16string_view text, Utf16ByteOrder order) {
+	std::string rv;
+	for (char16_t cu : text) {
+		const char lo = char(cu & 0xFF);
+		const char hi = char(cu >> 8);
+		if (order == Utf16ByteOrder::LittleEndian) {
+			rv += lo;
+			rv += hi;
+		} else {
+			rv += hi;
+			rv += lo;
+		}
+	}
+	return rv;
+}
+
+TEST(Utf16Transcoding, BothByteOrdersSurrogatesAndInPlace) {
+	// long enough for the vectorized ASCII path, with non-ASCII and a surrogate pair (U+1F600) somewhere in the middle:
+	std::u16string text;
+	std::string expected;
+	for (int i = 0; i < 20; i++) {
+		text += u"ASCII only, quite a bit of it. ";
+		expected += "ASCII only, quite a bit of it. ";
+		if (i % 7 == 3) {
+			text += u"café € \U0001F600 ";
+			expected += "caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80 ";
+		}
+	}
+
+	for (auto order : { Utf16ByteOrder::LittleEndian, Utf16ByteOrder::BigEndian }) {
+		const std::string src = utf16_bytes(text, order) + std::string(2, '\0') + "trailing junk";
+		const auto *usrc = reinterpret_cast<const uint8_t *>(src.data());
+		EXPECT_TRUE(looks_like_utf16(usrc, src.size(), order));
+		EXPECT_FALSE(looks_like_utf16(usrc, src.size(), order == Utf16ByteOrder::LittleEndian ? Utf16ByteOrder::BigEndian : Utf16ByteOrder::LittleEndian));
+
+		// into a separate buffer: stops at the NUL code unit.
+		std::string dst(src.size(), '?');
+		auto r = transcode_utf16_to_utf8(usrc, src.size(), order, reinterpret_cast<uint8_t *>(dst.data()), dst.size());
+		EXPECT_EQ(r.consumed, text.size() * 2);
+		EXPECT_EQ(dst.substr(0, r.written), expected);
+
+		// in place: UTF-8 is shorter here, so it all fits.
+		std::string buf = src;
+		r = transcode_utf16_to_utf8(usrc = reinterpret_cast<const uint8_t *>(buf.data()), buf.size(), order, reinterpret_cast<uint8_t *>(buf.data()), buf.size());
+		EXPECT_EQ(r.consumed, text.size() * 2);
+		EXPECT_EQ(buf.substr(0, r.written), expected);
+	}
+
+	// BOM detection:
+	Utf16ByteOrder order{};
+	EXPECT_EQ(utf16_bom_length(reinterpret_cast<const uint8_t *>("\xFF\xFEx\0"), 4, order), 2u);
+	EXPECT_EQ(order, Utf16ByteOrder::LittleEndian);
+	EXPECT_EQ(utf16_bom_length(reinterpret_cast<const uint8_t *>("\xFE\xFF\0x"), 4, order), 2u);
+	EXPECT_EQ(order, Utf16ByteOrder::BigEndian);
+	EXPECT_EQ(utf16_bom_length(reinterpret_cast<const uint8_t *>("ab"), 2, order), 0u);
+
+	// lone surrogates become U+FFFD; a high surrogate at the very end is left for the next round.
+	{
+		const std::string src = utf16_bytes(u"a\xDC00" u"b\xD800" u"c", Utf16ByteOrder::LittleEndian) + utf16_bytes(u"\xD800", Utf16ByteOrder::LittleEndian);
+		std::string dst(32, '?');
+		auto r = transcode_utf16_to_utf8(reinterpret_cast<const uint8_t *>(src.data()), src.size(), Utf16ByteOrder::LittleEndian, reinterpret_cast<uint8_t *>(dst.data()), dst.size());
+		EXPECT_EQ(r.consumed, src.size() - 2);
+		EXPECT_EQ(dst.substr(0, r.written), "a\xEF\xBF\xBD" "b\xEF\xBF\xBD" "c");
+	}
+
+	// in place, CJK takes 3 bytes for every 2 bytes of input: we must stop before we overwrite unread input.
+	{
+		std::string buf = utf16_bytes(u"一二三", Utf16ByteOrder::LittleEndian) + std::string(2, '\0');
+		auto r = transcode_utf16_to_utf8(reinterpret_cast<const uint8_t *>(buf.data()), buf.size(), Utf16ByteOrder::LittleEndian, reinterpret_cast<uint8_t *>(buf.data()), buf.size());
+		// 1st: 3 bytes written > 2 consumed --> stop right away.
+		EXPECT_EQ(r.consumed, 0u);
+		EXPECT_EQ(r.written, 0u);
+
+		// with some slack before the source (as we get after a bit of ASCII-in-UTF-16), the first two fit:
+		buf = "xx" + utf16_bytes(u"一二三", Utf16ByteOrder::LittleEndian) + std::string(2, '\0');
+		r = transcode_utf16_to_utf8(reinterpret_cast<const uint8_t *>(buf.data() + 2), buf.size() - 2, Utf16ByteOrder::LittleEndian, reinterpret_cast<uint8_t *>(buf.data()), buf.size());
+		EXPECT_EQ(r.consumed, 4u);
+		EXPECT_EQ(buf.substr(0, r.written), "\xE4\xB8\x80\xE4\xBA\x8C");
+		// ... and the input we didn't consume is still intact:
+		EXPECT_EQ(buf.substr(6, 2), utf16_bytes(u"三", Utf16ByteOrder::LittleEndian));
+	}
+}
+
+
+// clean it all up in a single pass, the way `RawTextIngest` does, minus the chunking.
+static std::string clean_raw_data(std::string raw) {
+	const size_t rawsize = raw.size();
+	raw.append(raw_data_tail_size, '\0');
+	std::vector<uint8_t> overflow;
+	RawTextCleanupState state;
+	std::string text;
+	size_t pos = 0;
+	for (;;) {
+		auto r = cleanRawDataIntoText(reinterpret_cast<uint8_t *>(raw.data() + pos), rawsize - pos, true, overflow, state);
+		text.append(raw.data() + pos, r.written);
+		text.append(overflow.begin(), overflow.end());
+		pos += r.consumed;
+		if (overflow.empty())
+			break;
+	}
+	EXPECT_EQ(pos, rawsize);
+	return text;
+}
+
+TEST(RawTextIngest, ChunkedMatchesSinglePass) {
+	// mixed raw input: ASCII, UTF-8, CRLF, control characters, DEL, a stray invalid byte and UTF-16 runs, both
+	// ASCII and not: CJK and surrogate pairs, which straddle the chunk boundaries just like everything else.
+	std::u16string cjk;
+	std::string cjk_utf8;
+	for (int i = 0; i < 40; i++) {
+		cjk += u"中文字符测试 \U0001F600 ";
+		cjk_utf8 += "中文字符测试 \xF0\x9F\x98\x80 ";
+	}
+	std::string raw;
+	for (int i = 0; i < 300; i++) {
+		raw += std::format("line {} caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80\r\n", i);
+		if (i % 37 == 5)
+			raw += "bell\x07 del\x7F bad\xFF byte\n";
+		if (i % 91 == 17)
+			raw += utf16_bytes(u"UTF-16 in the middle of it all\r\n", Utf16ByteOrder::LittleEndian) + std::string(2, '\0');
+		if (i % 53 == 7)
+			raw += "\xFF\xFE" + utf16_bytes(cjk, Utf16ByteOrder::LittleEndian) + std::string(2, '\0');
+		if (i % 67 == 30)
+			raw += "\xFE\xFF" + utf16_bytes(cjk, Utf16ByteOrder::BigEndian) + std::string(2, '\0');
+		if (i % 71 == 40)
+			raw += utf16_bytes(u"ab" + cjk, Utf16ByteOrder::LittleEndian) + std::string(2, '\0');
+	}
+	raw += "the end";
+
+	std::string expected = clean_raw_data(raw);
+	EXPECT_EQ(expected.find('\r'), std::string::npos);
+	EXPECT_NE(expected.find("UTF-16 in the middle of it all\n"), std::string::npos);
+	EXPECT_NE(expected.find("\n" + cjk_utf8 + "\n"), std::string::npos);
+	EXPECT_NE(expected.find("ab" + cjk_utf8 + "\n"), std::string::npos);
+	EXPECT_NE(expected.find("bell\n del\n bad\n byte\n"), std::string::npos);
+
+	const path filepath = std::filesystem::temp_directory_path() / "text_processing_raw_ingest_test.bin";
+	{
+		std::ofstream f(filepath, std::ios::binary);
+		f << raw;
+	}
+
+	// chunk boundaries everywhere: in the middle of UTF-8 sequences, CRLF pairs and UTF-16 code units.
+	for (size_t chunk_size : { 64, 65, 77, 100, 1000, 4096 }) {
+		RawTextIngest ingest(chunk_size);
+		auto e = ingest.ingest(filepath);
+		ASSERT_FALSE(e.has_value()) << e->message;
+		EXPECT_EQ(ingest.text().content_view(), expected) << "chunk size " << chunk_size;
+		EXPECT_EQ(ingest.text().data()[expected.size()], 0);
+
+		// stdio streams go through the same stage, and a second source is appended to the first.
+		FILE *fin = fopen(filepath.string().c_str(), "rb");
+		ASSERT_NE(fin, nullptr);
+		e = ingest.ingest(fin);
+		fclose(fin);
+		ASSERT_FALSE(e.has_value()) << e->message;
+		EXPECT_EQ(ingest.text().content_view(), expected + expected) << "chunk size " << chunk_size;
+
+		TextBuffer text = ingest.take_text();
+		EXPECT_EQ(text.content_length(), 2 * expected.size());
+		EXPECT_EQ(ingest.text().content_length(), 0u);
+	}
+
+	// the buffer is sized for the file once; no growing along the way, as long as the text doesn't outgrow the raw data.
+	{
+		std::ofstream f(filepath, std::ios::binary);
+		f << std::string(1000, 'x');
+	}
+	RawTextIngest ingest(64);
+	ASSERT_FALSE(ingest.ingest(filepath).has_value());
+	EXPECT_EQ(ingest.text().content_length(), 1000u);
+	EXPECT_LE(ingest.text().capacity(), 1000 + raw_data_tail_size + TextBuffer::sentinel_size);
+	std::filesystem::remove(filepath);
+
+	EXPECT_TRUE(RawTextIngest{}.ingest(filepath).has_value());
+}
+
+
+TEST(RawTextIngest, CjkUtf16OutgrowsTheRawData) {
+	// 3 bytes of UTF-8 for every 2 bytes of UTF-16: the text ends up larger than the raw data.
+	std::u16string cjk;
+	for (int i = 0; i < 500; i++)
+		cjk += u"中文字符测试";
+	std::string cjk_utf8;
+	for (int i = 0; i < 500; i++)
+		cjk_utf8 += "中文字符测试";
+
+	const std::string with_bom = "\xFF\xFE" + utf16_bytes(cjk, Utf16ByteOrder::LittleEndian) + std::string(2, '\0') + "done";
+	const std::string without_bom = utf16_bytes(u"ab" + cjk, Utf16ByteOrder::LittleEndian) + std::string(2, '\0') + "done";
+	const std::string expected_with_bom = cjk_utf8 + "\n\ndone";
+	const std::string expected_without_bom = "ab" + cjk_utf8 + "\n\ndone";
+	EXPECT_EQ(clean_raw_data(with_bom), expected_with_bom);
+	EXPECT_EQ(clean_raw_data(without_bom), expected_without_bom);
+
+	const path filepath = std::filesystem::temp_directory_path() / "text_processing_raw_ingest_cjk_test.bin";
+	for (const auto &[raw, expected] : { std::pair{with_bom, expected_with_bom}, std::pair{without_bom, expected_without_bom} }) {
+		{
+			std::ofstream f(filepath, std::ios::binary);
+			f << "ASCII up front\n" << raw;
+		}
+		RawTextIngest ingest;
+		auto e = ingest.ingest(filepath);
+		ASSERT_FALSE(e.has_value()) << e->message;
+		EXPECT_EQ(ingest.text().content_view(), "ASCII up front\n" + expected);
+		EXPECT_EQ(ingest.text().data()[ingest.text().content_length()], 0);
+	}
+	std::filesystem::remove(filepath);
+}
+
+
+TEST(CodeStripping, KeepsTheLeftEdgeOutline) {
+	const std::string_view source =
+		"/*\n"
+		"   file header\n"
+		"   { not a scope }\n"
+		"*/\n"
+		"#include <stdio.h>\n"
+		"#define MAX(a, b) \\\n"
+		"    ((a) > (b) ? (a) : (b))\n"
+		"#if defined(FOO)\n"
+		"\n"
+		"\n"
+		"extern \"C\" {\n"
+		"// the API:\n"
+		"int foo(int a);\n"
+		"}\n"
+		"namespace demo\n"
+		"{\n"
+		"namespace fs = std::filesystem;\n"
+		"struct S {\n"
+		"    int x = '{';\n"
+		"    const char *s = \"}}\";\n"
+		"    // }\n"
+		"};\n"
+		"static int bar(int a) {\n"
+		"    if (a) {\n"
+		"#define INNER 1\n"
+		"int not_at_top = 1'000;\n"
+		"    }\n"
+		"    /* } */ return a;\n"
+		"}\n"
+		"    int indented_decl;\n"
+		"void baz()\n"
+		"{\n"
+		"    return;\n"
+		"}\n"
+		"}  // namespace demo\n"
+		"int last(void);\r\n";
+
+	CodeStripper stripper;
+	std::vector<std::string_view> lines;
+	stripper.strip(source, lines);
+	EXPECT_EQ(stripper.scope_depth(), 0u);
+
+	const std::vector<std::string> expected = {
+		"/*",
+		"   file header",
+		"   { not a scope }",
+		"*/",
+		"#define MAX(a, b) \\",
+		"    ((a) > (b) ? (a) : (b))",
+		"// the API:",
+		"int foo(int a);",
+		"namespace fs = std::filesystem;",
+		"struct S",
+		"static int bar(int a)",
+		"void baz()",
+		"int last(void);",
+	};
+	EXPECT_EQ(as_strings(lines), expected);
+
+	// fed in line-aligned pieces, the state carries over:
+	CodeStripper pieces;
+	std::vector<std::string_view> piecemeal;
+	size_t pos = 0;
+	while (pos < source.size()) {
+		const size_t eol = std::min(source.find('\n', pos), source.size() - 1);
+		pieces.strip(source.substr(pos, eol + 1 - pos), piecemeal);
+		pos = eol + 1;
+	}
+	EXPECT_EQ(as_strings(piecemeal), expected);
+}
+
+
+TEST(RawTextIngest, ParallelFilesDeliveredInOrder) {
+	std::vector<path> files;
+	for (int i = 0; i < 30; i++) {
+		path filepath = std::filesystem::temp_directory_path() / std::format("text_processing_parallel_ingest_test_{}.c", i);
+		std::ofstream f(filepath, std::ios::binary);
+		f << "// file " << i << "\r\nint f" << i << "(void) {\r\n" << std::string(200 * i, 'z') << "\r\n}\r\n";
+		files.push_back(filepath);
+	}
+	files.insert(files.begin() + 7, std::filesystem::temp_directory_path() / "text_processing_parallel_ingest_test_nonexistent.c");
+
+	RawTextIngestOptions opts{
+		.thread_count = 4,
+		.max_in_flight_bytes = 2000,
+		.chunk_size = 256,
+	};
+	std::vector<size_t> order;
+	size_t failures = 0;
+	auto r = ingestFiles(files, [](size_t, const path &, IngestedFile &file) {
+		CodeStripper stripper;
+		stripper.strip(file.text.content_view(), file.lines);
+	}, [&](size_t index, const path &filepath, IngestedFile &file) {
+		order.push_back(index);
+		if (file.error) {
+			failures++;
+			return true;
+		}
+		const int i = int(index < 7 ? index : index - 1);
+		// CR becomes LF: same size.
+		EXPECT_EQ(file.text.content_length(), std::filesystem::file_size(filepath));
+		EXPECT_EQ(file.text.content_view().find('\r'), std::string_view::npos);
+		EXPECT_EQ(as_strings(file.lines), (std::vector<std::string>{ std::format("// file {}", i), std::format("int f{}(void)", i) }));
+		return true;
+	}, opts);
+	ASSERT_TRUE(r.has_value());
+	EXPECT_EQ(r.value(), files.size());
+	EXPECT_EQ(failures, 1u);
+	ASSERT_EQ(order.size(), files.size());
+	for (size_t i = 0; i < order.size(); i++)
+		EXPECT_EQ(order[i], i);
+
+	// abort after the first few
+	size_t seen = 0;
+	r = ingestFiles(files, nullptr, [&](size_t, const path &, IngestedFile &) {
+		return ++seen < 3;
+	}, opts);
+	ASSERT_TRUE(r.has_value());
+	EXPECT_EQ(r.value(), 3u);
+
+	for (const auto &filepath : files)
+		std::filesystem::remove(filepath);
+}
 
 
 extern "C"
@@ -3,8 +3,45 @@
 
 #include "PrivateIntrinsics.hpp"
 
+#include <new>
+#include <atomic>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#else
+#include <malloc.h>
+#endif
+
 namespace text_processing {
 
+	// `StorageKind::Aligned` memory: C11 `aligned_alloc()` would do, if only MSVC had it...
+	static char *alloc_aligned(size_t amount, size_t alignment) {
+#if defined(_WIN32)
+		return reinterpret_cast<char *>(_aligned_malloc(amount, alignment));
+#else
+		void *p = nullptr;
+		if (posix_memalign(&p, std::max(alignment, sizeof(void *)), amount) != 0)
+			return nullptr;
+		return reinterpret_cast<char *>(p);
+#endif
+	}
+
+	static void free_aligned(char *p) {
+#if defined(_WIN32)
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+
+	// we don't keep the alignment around: for `grow()` the alignment of the current buffer start is good enough.
+	static size_t alignment_of(const char *p) {
+		const uintptr_t a = reinterpret_cast<uintptr_t>(p);
+		return std::min<size_t>(a & (~a + 1), 64 * 1024);
+	}
+
 	// local helper, which knows about our buffersize shenanigans in the TextBuffer class.
 	// Hence very local.  ;-)
 	static char *alloc_and_copy_string(const char *str, size_t strlength, size_t requested_buffer_size) {
@@ -70,20 +107,46 @@ namespace text_processing {
 	// nuke/reset the Textbuffer
 	void TextBuffer::clear(void) {
 		if (_data != nullptr) {
-			free(_data);
+			switch (_storage) {
+			case StorageKind::Heap:
+				free(_data);
+				break;
+
+			case StorageKind::MemoryMapped:
+#if !defined(_WIN32)
+				munmap(_data, _capacity);
+#endif
+				break;
+
+			case StorageKind::Arena:
+				// the arena owns this one.
+				break;
+
+			case StorageKind::Aligned:
+				free_aligned(_data);
+				break;
+			}
 		}
 		_data = nullptr;
 		_length = 0;
 		_occupied = 0;
 		_capacity = 0;
+		_storage = StorageKind::Heap;
 	}
 
 	TextBuffer::~TextBuffer() {
 		clear();
 	}
 
+	static std::atomic<size_t> buffer_content_copy_count{0};
+
+	size_t TextBuffer::content_copy_count() noexcept {
+		return buffer_content_copy_count.load(std::memory_order_relaxed);
+	}
+
 	TextBuffer::TextBuffer(const TextBuffer &src) {
 		if (false) std::cout << "copy constructed\n";
+		buffer_content_copy_count.fetch_add(1, std::memory_order_relaxed);
 
 		_data = reinterpret_cast<char *>(malloc(src._capacity));
 		if (_data == nullptr)
@@ -101,7 +164,8 @@ namespace text_processing {
 		_length(std::move(lvsrc._length)),
 		_occupied(std::move(lvsrc._occupied)),
 		_data(std::move(lvsrc._data)),
-		_capacity(std::move(lvsrc._capacity)) {
+		_capacity(std::move(lvsrc._capacity)),
+		_storage(lvsrc._storage) {
 
 		if (false) std::cout << "move constructed\n";
 
@@ -110,11 +174,18 @@ namespace text_processing {
 		lvsrc._length = 0;
 		lvsrc._occupied = 0;
 		lvsrc._capacity = 0;
+		lvsrc._storage = StorageKind::Heap;
 	}
 
 	TextBuffer& TextBuffer::operator=(const TextBuffer& src)
 	{
 		if (false) std::cout << "copy assigned\n";
+		buffer_content_copy_count.fetch_add(1, std::memory_order_relaxed);
+
+		// a copy always lands in heap memory: we can't (and won't) write into a file mapping.
+		if (_storage != StorageKind::Heap) {
+			clear();
+		}
 
 		// only alloc the same amount as `src` when nothing has been prepared yet:
 		if (_data == nullptr) {
@@ -147,16 +218,24 @@ namespace text_processing {
 	{
 		if (false) std::cout << "move assigned\n";
 
+		if (this == &src) {
+			return *this;
+		}
+		// release what we had: leaking a file mapping is a tad worse than leaking a bit of heap.
+		clear();
+
 		_length = std::move(src._length);
 		_occupied = std::move(src._occupied);
 		_data = std::move(src._data);
 		_capacity = std::move(src._capacity);
+		_storage = src._storage;
 
 		// clear src but DO NOT free src._data as that one was moved into `*this`
 		src._data = nullptr;
 		src._length = 0;
 		src._occupied = 0;
 		src._capacity = 0;
+		src._storage = StorageKind::Heap;
 
 		return *this;
 	}
@@ -164,6 +243,10 @@ namespace text_processing {
 	TextBuffer& TextBuffer::operator=(const std::string_view &str) {
 		if (false) std::cout << "copy assigned\n";
 
+		if (_storage != StorageKind::Heap) {
+			clear();
+		}
+
 		// only alloc the same amount as `src` when nothing has been prepared yet:
 		if (_data == nullptr) {
 			_capacity = str.length() + sentinel_size;
@@ -192,6 +275,10 @@ namespace text_processing {
 
 		size_t strlength = strlen(str);
 
+		if (_storage != StorageKind::Heap) {
+			clear();
+		}
+
 		// only alloc the same amount as `src` when nothing has been prepared yet:
 		if (_data == nullptr) {
 			_capacity = strlength + sentinel_size;
@@ -247,6 +334,96 @@ namespace text_processing {
 		_capacity = amount;
 	}
 
+	void TextBuffer::reserve(size_t amount, TextBufferArena &arena, std::error_code &ec) {
+		ec.clear();
+
+		assert(_data == nullptr);
+		assert(_length == 0);
+		assert(_occupied == 0);
+		assert(_capacity == 0);
+
+		amount += sentinel_size;  // plenty space for sentinels
+		_data = arena.allocate(amount);
+		if (_data == nullptr) {
+			ec = std::make_error_code(std::errc::not_enough_memory);
+			return;
+		}
+		_capacity = amount;
+		_storage = StorageKind::Arena;
+	}
+
+	void TextBuffer::reserve_aligned(size_t amount, size_t alignment, std::error_code &ec) {
+		ec.clear();
+
+		assert(_data == nullptr);
+		assert(_length == 0);
+		assert(_occupied == 0);
+		assert(_capacity == 0);
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+		amount += sentinel_size;  // plenty space for sentinels
+		amount = (amount + alignment - 1) & ~(alignment - 1);
+		_data = alloc_aligned(amount, alignment);
+		if (_data == nullptr) {
+			ec = std::make_error_code(std::errc::not_enough_memory);
+			return;
+		}
+		_capacity = amount;
+		_storage = StorageKind::Aligned;
+	}
+
+	void TextBuffer::grow(size_t amount, std::error_code &ec) {
+		ec.clear();
+
+		amount += sentinel_size;  // plenty space for sentinels
+		if (amount <= _capacity)
+			return;
+
+		switch (_storage) {
+		case StorageKind::Heap: {
+				char *p = reinterpret_cast<char *>(realloc(_data, amount));
+				if (p == nullptr) {
+					ec = std::make_error_code(std::errc::not_enough_memory);
+					return;
+				}
+				_data = p;
+			}
+			break;
+
+		case StorageKind::Arena: {
+				char *p = reinterpret_cast<char *>(malloc(amount));
+				if (p == nullptr) {
+					ec = std::make_error_code(std::errc::not_enough_memory);
+					return;
+				}
+				memcpy(p, _data, _capacity);
+				_data = p;
+				_storage = StorageKind::Heap;
+			}
+			break;
+
+		case StorageKind::Aligned: {
+				const size_t alignment = alignment_of(_data);
+				amount = (amount + alignment - 1) & ~(alignment - 1);
+				char *p = alloc_aligned(amount, alignment);
+				if (p == nullptr) {
+					ec = std::make_error_code(std::errc::not_enough_memory);
+					return;
+				}
+				memcpy(p, _data, _capacity);
+				free_aligned(_data);
+				_data = p;
+			}
+			break;
+
+		case StorageKind::MemoryMapped:
+		default:
+			ec = std::make_error_code(std::errc::operation_not_supported);
+			return;
+		}
+		_capacity = amount;
+	}
+
 	void TextBuffer::set_content_size(size_t amount) {
 		assert(amount > 0 ? _data != nullptr : true);
 		assert(_capacity >= amount + 1);
@@ -264,6 +441,13 @@ namespace text_processing {
 		_occupied = _length + sentinel_size;
 	}
 
+	void TextBuffer::ensure_text_edge_sentinel(void) {
+		assert(_length + sentinel_size <= _capacity);
+		memset(_data + _length, '\0', sentinel_size);
+
+		_occupied = std::max(_occupied, _length + sentinel_size);
+	}
+
 	void TextBuffer::mark_this_space_as_occupied(size_t amount) {
 		assert(_occupied + amount <= _capacity);
 		_occupied += amount;
@@ -283,5 +467,140 @@ namespace text_processing {
 		write_text_edge_sentinel();
 	}
 
-}
+	void TextBuffer::map_file(int fd, size_t filesize, size_t requested_buffer_size, std::error_code &ec) {
+		ec.clear();
+
+		assert(_data == nullptr);
+		assert(_length == 0);
+		assert(_occupied == 0);
+		assert(_capacity == 0);
+
+#if defined(_WIN32)
+		// MapViewOfFile() cannot be told to place the view in front of our scratch space without jumping through
+		// the VirtualAlloc2() placeholder hoops, so we don't do this on Windows (yet).
+		ec = std::make_error_code(std::errc::function_not_supported);
+#else
+		const size_t page_size = sysconf(_SC_PAGESIZE);
+		size_t amount = std::max(filesize + sentinel_size, requested_buffer_size);
+		amount = (amount + page_size - 1) & ~(page_size - 1);
+
+		// first reserve the entire address range as anonymous (zeroed, lazily committed) memory,
+		// then lay the file content over the start of it: that way the NUL sentinel and the scratch space
+		// come for free, directly following the file content, just like in a heap-allocated TextBuffer.
+		void *region = mmap(nullptr, amount, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (region == MAP_FAILED) {
+			ec = std::error_code(errno, std::generic_category());
+			return;
+		}
+		if (filesize > 0) {
+			// MAP_PRIVATE: the sentinel write below copies (only) the page carrying the tail end of the file; nothing ever lands in the file itself.
+			void *view = mmap(region, filesize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+			if (view == MAP_FAILED) {
+				ec = std::error_code(errno, std::generic_category());
+				munmap(region, amount);
+				return;
+			}
+			(void)madvise(view, filesize, MADV_SEQUENTIAL);
+
+			// lock down all the whole pages of file content: views into the page cache must stay that way.
+			// The last (partial) page remains writable as it hosts (the start of) the sentinel.
+			if (const size_t locked = filesize & ~(page_size - 1); locked > 0) {
+				(void)mprotect(view, locked, PROT_READ);
+			}
+		}
+
+		_data = reinterpret_cast<char *>(region);
+		_capacity = amount;
+		_length = filesize;
+		_storage = StorageKind::MemoryMapped;
+		write_text_edge_sentinel();
+#endif
+	}
+
+	// ------------------------------------------------------------------------------------
+
+	TextBufferArena::TextBufferArena(size_t slab_size) :
+		_slab_size(std::max(slab_size, 4 * alignment)) {
+	}
+
+	TextBufferArena::~TextBufferArena() {
+		release();
+	}
+
+	TextBufferArena::TextBufferArena(TextBufferArena &&src) noexcept :
+		_slab_size(src._slab_size),
+		_slabs(std::move(src._slabs)),
+		_current(src._current),
+		_offset(src._offset) {
+		src._slabs.clear();
+		src._current = 0;
+		src._offset = 0;
+	}
 
+	TextBufferArena &TextBufferArena::operator=(TextBufferArena &&src) noexcept {
+		if (this != &src) {
+			release();
+			_slab_size = src._slab_size;
+			_slabs = std::move(src._slabs);
+			_current = src._current;
+			_offset = src._offset;
+			src._slabs.clear();
+			src._current = 0;
+			src._offset = 0;
+		}
+		return *this;
+	}
+
+	char *TextBufferArena::allocate(size_t amount) noexcept {
+		amount = (amount + alignment - 1) & ~(alignment - 1);
+
+		// fast path: bump the offset in the current slab.
+		if (_current < _slabs.size() && _slabs[_current].size - _offset >= amount) {
+			char *rv = _slabs[_current].base + _offset;
+			_offset += amount;
+			return rv;
+		}
+
+		// move on to the next slab; after a `reset()` there may be a few left which are large enough.
+		// Otherwise, grab a fresh one: slab-sized or, for large requests, a dedicated one.
+		size_t next = (_current < _slabs.size() ? _current + 1 : _current);
+		if (next >= _slabs.size() || _slabs[next].size < amount) {
+			const size_t size = std::max(_slab_size, amount);
+			char *base = reinterpret_cast<char *>(::operator new(size, std::align_val_t{alignment}, std::nothrow));
+			if (base == nullptr)
+				return nullptr;
+			try {
+				_slabs.insert(_slabs.begin() + next, Slab{base, size});
+			} catch (...) {
+				::operator delete(base, std::align_val_t{alignment});
+				return nullptr;
+			}
+		}
+		_current = next;
+		_offset = amount;
+		return _slabs[_current].base;
+	}
+
+	void TextBufferArena::reset() noexcept {
+		_current = 0;
+		_offset = 0;
+	}
+
+	void TextBufferArena::release() noexcept {
+		for (auto &slab : _slabs) {
+			::operator delete(slab.base, std::align_val_t{alignment});
+		}
+		_slabs.clear();
+		_current = 0;
+		_offset = 0;
+	}
+
+	size_t TextBufferArena::slab_space() const noexcept {
+		size_t rv = 0;
+		for (const auto &slab : _slabs) {
+			rv += slab.size;
+		}
+		return rv;
+	}
+
+}